@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "AlbumEncodingVote.h"
+
+namespace android {
+
+AlbumEncodingVote::AlbumEncodingVote(uint32_t margin)
+    : _margin(margin ? margin : 1)
+{
+    clear();
+}
+
+void AlbumEncodingVote::clear()
+{
+    _decision = kUndecided;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void AlbumEncodingVote::vote(Decision decision)
+{
+    _stats.files++;
+    _stats.votes[decision]++;
+
+    uint32_t native = _stats.votes[kLocaleEncoding];
+    uint32_t latin1 = _stats.votes[kLatin1];
+    if (native >= latin1 + _margin)
+        _decision = kLocaleEncoding;
+    else if (latin1 >= native + _margin)
+        _decision = kLatin1;
+    else
+        _decision = kUndecided;
+}
+
+void AlbumEncodingVote::countDecidedFile(bool followed)
+{
+    _stats.decidedFiles++;
+    if (followed)
+        _stats.followedFiles++;
+}
+
+}
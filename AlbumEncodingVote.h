@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ALBUM_ENCODING_VOTE_H
+#define ALBUM_ENCODING_VOTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// How the native tags of the files of one album, or one directory, are
+// encoded, decided by the files together.
+//
+// A file alone can be too short to tell: "Beyonc\xE9" is Latin-1, but
+// also EUC-KR chopped after a lead byte, and a two byte title is well
+// formed in about any double byte encoding. TagConverter::endFile()
+// votes with each file that tells, either for the locale encoding or
+// for Latin-1, and once one side leads by the margin the album is
+// decided. A file that can't tell then follows the album instead of its
+// own bytes, and the tags of later files are only checked against the
+// locale encoding. A file that tells goes its own way all the same, and
+// still votes, so a mixed album can turn undecided again.
+//
+// Use one per album on one thread, and clear() it for the next.
+class AlbumEncodingVote {
+public:
+    enum Decision {
+        kUndecided,
+        kLocaleEncoding,
+        kLatin1,
+    };
+
+    struct Stats {
+        uint32_t files;         // with tags that needed detection
+        uint32_t votes[3];      // by Decision; kUndecided for can't tell
+        uint32_t decidedFiles;  // that came after the album was decided
+        uint32_t followedFiles; // that couldn't tell and followed it
+    };
+
+    explicit AlbumEncodingVote(uint32_t margin = 3);
+
+    void clear();
+
+    // the file's own evidence; kUndecided if it can't tell.
+    void vote(Decision decision);
+    Decision decision() const { return _decision; }
+
+    // counts a file that came after the decision, and one that followed it.
+    void countDecidedFile(bool followed);
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    uint32_t _margin;
+    Decision _decision;
+    Stats _stats;
+};
+
+}
+
+#endif // ALBUM_ENCODING_VOTE_H
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AllocationCounter"
+#include <utils/Log.h>
+
+#include <new>
+#include <stdlib.h>
+
+#include <cutils/atomic.h>
+#include <unicode/uclean.h>
+
+#include "AllocationCounter.h"
+
+namespace android {
+
+static volatile int32_t sAllocations;
+static volatile int32_t sBytes;
+static bool sIsIcuCounted;
+
+static inline void count(size_t size)
+{
+    android_atomic_inc(&sAllocations);
+    android_atomic_add((int32_t)size, &sBytes);
+}
+
+static void* U_CALLCONV icuAlloc(const void* context, size_t size)
+{
+    count(size);
+    return malloc(size);
+}
+
+static void* U_CALLCONV icuRealloc(const void* context, void* mem, size_t size)
+{
+    count(size);
+    return realloc(mem, size);
+}
+
+static void U_CALLCONV icuFree(const void* context, void* mem)
+{
+    free(mem);
+}
+
+static bool installIcuHooks()
+{
+    UErrorCode status = U_ZERO_ERROR;
+    u_setMemoryFunctions(NULL, icuAlloc, icuRealloc, icuFree, &status);
+    if (U_FAILURE(status)) {
+        LOGE("u_setMemoryFunctions failed: %d\n", status);
+        return false;
+    }
+    return true;
+}
+
+// before main(), while ICU is still untouched.
+static struct IcuHooks {
+    IcuHooks() { sIsIcuCounted = installIcuHooks(); }
+} sIcuHooks;
+
+AllocationCounter::Counts AllocationCounter::now()
+{
+    Counts counts;
+    counts.allocations = android_atomic_add(0, &sAllocations);
+    counts.bytes = android_atomic_add(0, &sBytes);
+    return counts;
+}
+
+AllocationCounter::Counts AllocationCounter::since(const Counts& then)
+{
+    Counts counts = now();
+    counts.allocations -= then.allocations;
+    counts.bytes -= then.bytes;
+    return counts;
+}
+
+bool AllocationCounter::isIcuCounted()
+{
+    return sIsIcuCounted;
+}
+
+}
+
+static void* countedNew(size_t size)
+{
+    android::count(size);
+    // operator new never returns NULL, even for a size of 0.
+    void* p = malloc(size ? size : 1);
+    if (p == NULL)
+        abort();
+    return p;
+}
+
+void* operator new(size_t size)
+{
+    return countedNew(size);
+}
+
+void* operator new[](size_t size)
+{
+    return countedNew(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+    android::count(size);
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+    android::count(size);
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+    free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+    free(p);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Counts the heap allocations of a binary linking AllocationCounter.cpp.
+//
+// That file replaces the global operator new and delete, and routes
+// ICU's heap through u_setMemoryFunctions() before main(), so what the
+// converters allocate counts too. malloc() called by the shared
+// libraries, libmedia's StringArray among them, goes around both and
+// isn't counted.
+//
+// Counts are process wide, so take them while one thread is allocating.
+class AllocationCounter {
+public:
+    struct Counts {
+        int32_t allocations;
+        int32_t bytes;
+    };
+
+    static Counts now();
+
+    // Allocations made since then.
+    static Counts since(const Counts& then);
+
+    // Whether ICU took the hooks; it refuses them once it has allocated.
+    static bool isIcuCounted();
+};
+
+}
+
+#endif // ALLOCATION_COUNTER_H
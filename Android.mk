@@ -4,12 +4,38 @@ include $(CLEAR_VARS)
 
 ifneq ($(TARGET_SIMULATOR),true)
 
+# Sources shared by the tests and the benchmarks.
+common_src_files := \
+	AlbumEncodingVote.cpp \
+	ConverterCache.cpp \
+	DetectionCache.cpp \
+	Id3Reader.cpp \
+	Latin1Utf8.cpp \
+	NativeEncodingDetector.cpp \
+	ScanDriver.cpp \
+	ScanPipeline.cpp \
+	ScanStats.cpp \
+	SpscQueue.cpp \
+	SyntheticMp3.cpp \
+	TagArena.cpp \
+	TagConverter.cpp \
+	TagNameTable.cpp \
+	TagPrescreen.cpp \
+	TagResults.cpp \
+	TesteeCorpus.cpp \
+	Utf16Utf8.cpp
+
 # Build the unit tests.
 test_src_files := \
 	MediaScannerClient_test.cpp
 
+# Only in the unit tests: it replaces the global operator new.
+test_support_src_files := \
+	AllocationCounter.cpp
+
 shared_libraries := \
 	libstlport \
+	libcutils \
 	libutils \
 	libmedia \
 	libicuuc
@@ -27,12 +53,33 @@ c_includes := \
 
 module_tags := eng tests
 
+# SCAN_STATS=true builds in the counters and timers of ScanStats.h.
+ifeq ($(SCAN_STATS),true)
+cflags := -DSCAN_STATS_ENABLED=1
+endif
+
 $(foreach file,$(test_src_files), \
     $(eval include $(CLEAR_VARS)) \
     $(eval LOCAL_SHARED_LIBRARIES := $(shared_libraries)) \
     $(eval LOCAL_STATIC_LIBRARIES := $(static_libraries)) \
     $(eval LOCAL_C_INCLUDES := $(c_includes)) \
-    $(eval LOCAL_SRC_FILES := $(file)) \
+    $(eval LOCAL_CFLAGS := $(cflags)) \
+    $(eval LOCAL_SRC_FILES := $(file) $(common_src_files) $(test_support_src_files)) \
+    $(eval LOCAL_MODULE := $(notdir $(file:%.cpp=%))) \
+    $(eval LOCAL_MODULE_TAGS := $(module_tags)) \
+    $(eval include $(BUILD_EXECUTABLE)) \
+)
+
+# Build the benchmarks. They have their own main(), so no gtest here.
+benchmark_src_files := \
+	MediaScannerClient_benchmark.cpp
+
+$(foreach file,$(benchmark_src_files), \
+    $(eval include $(CLEAR_VARS)) \
+    $(eval LOCAL_SHARED_LIBRARIES := $(shared_libraries)) \
+    $(eval LOCAL_C_INCLUDES := $(c_includes)) \
+    $(eval LOCAL_CFLAGS := $(cflags)) \
+    $(eval LOCAL_SRC_FILES := $(file) $(common_src_files)) \
     $(eval LOCAL_MODULE := $(notdir $(file:%.cpp=%))) \
     $(eval LOCAL_MODULE_TAGS := $(module_tags)) \
     $(eval include $(BUILD_EXECUTABLE)) \
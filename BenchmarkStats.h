@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BENCHMARK_STATS_H
+#define BENCHMARK_STATS_H
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include <utils/Timers.h>
+
+namespace android {
+
+// Collects latency samples of one benchmark case and reports
+// throughput and percentiles of them.
+class BenchmarkStats {
+private:
+    std::vector<nsecs_t> _samples;
+    nsecs_t _total;
+    bool _isSorted;
+
+public:
+    BenchmarkStats() : _total(0), _isSorted(true) {}
+
+    void reserve(size_t count) {
+        _samples.reserve(count);
+    }
+
+    void clear() {
+        _samples.clear();
+        _total = 0;
+        _isSorted = true;
+    }
+
+    // a sample is a latency of one timed region, in nanoseconds.
+    void addSample(nsecs_t sample) {
+        _samples.push_back(sample);
+        _isSorted = false;
+    }
+
+    // total wall time of the case, which may cover more than the samples.
+    void addTotal(nsecs_t elapsed) {
+        _total += elapsed;
+    }
+
+    nsecs_t total() const {
+        return _total;
+    }
+
+    size_t count() const {
+        return _samples.size();
+    }
+
+    // nearest-rank percentile, pct in [0, 100].
+    nsecs_t percentile(double pct) {
+        if (_samples.empty())
+            return 0;
+        if (!_isSorted) {
+            std::sort(_samples.begin(), _samples.end());
+            _isSorted = true;
+        }
+        size_t rank = (size_t)(pct / 100.0 * _samples.size() + 0.5);
+        if (rank > 0)
+            rank--;
+        if (rank >= _samples.size())
+            rank = _samples.size() - 1;
+        return _samples[rank];
+    }
+
+    // events per second over total().
+    double rate(double events) const {
+        if (_total <= 0)
+            return 0;
+        return events * 1000000000.0 / _total;
+    }
+};
+
+static inline double nsToUs(nsecs_t ns) {
+    return ns / 1000.0;
+}
+
+}
+
+#endif // BENCHMARK_STATS_H
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ConverterCache"
+#include <utils/Log.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#include "ConverterCache.h"
+#include "ScanStats.h"
+
+namespace android {
+
+static pthread_key_t sCacheKey;
+static pthread_once_t sCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+void ConverterCache::createKey()
+{
+    pthread_key_create(&sCacheKey, destroyThreadCache);
+}
+
+void ConverterCache::destroyThreadCache(void* cache)
+{
+    delete static_cast<ConverterCache*>(cache);
+}
+
+ConverterCache* ConverterCache::threadCache(bool create)
+{
+    pthread_once(&sCacheKeyOnce, createKey);
+    ConverterCache* cache = static_cast<ConverterCache*>(pthread_getspecific(sCacheKey));
+    if (cache == NULL && create) {
+        cache = new ConverterCache();
+        pthread_setspecific(sCacheKey, cache);
+    }
+    return cache;
+}
+
+ConverterCache::~ConverterCache()
+{
+    for (size_t i = 0; i < _entries.size(); i++)
+        ucnv_close(_entries[i].conv);
+}
+
+UConverter* ConverterCache::lookup(const char* charset, UErrorCode* status)
+{
+    for (size_t i = 0; i < _entries.size(); i++) {
+        if (!ucnv_compareNames(_entries[i].name, charset)) {
+            ucnv_reset(_entries[i].conv);
+            return _entries[i].conv;
+        }
+    }
+
+    if (strlen(charset) >= kMaxNameLength) {
+        *status = U_ILLEGAL_ARGUMENT_ERROR;
+        return NULL;
+    }
+
+    UConverter* conv = ucnv_open(charset, status);
+    if (U_FAILURE(*status)) {
+        LOGE("could not create UConverter for %s\n", charset);
+        return NULL;
+    }
+    _openCount++;
+    SCAN_STATS_ADD(converterOpens, 1);
+
+    Entry entry;
+    strcpy(entry.name, charset);
+    entry.conv = conv;
+    _entries.push_back(entry);
+    return conv;
+}
+
+UConverter* ConverterCache::get(const char* charset, UErrorCode* status)
+{
+    if (U_FAILURE(*status))
+        return NULL;
+    return threadCache(true)->lookup(charset, status);
+}
+
+void ConverterCache::releaseThreadCache()
+{
+    ConverterCache* cache = threadCache(false);
+    if (cache == NULL)
+        return;
+    pthread_setspecific(sCacheKey, NULL);
+    delete cache;
+}
+
+int ConverterCache::openCount()
+{
+    ConverterCache* cache = threadCache(false);
+    return cache ? cache->_openCount : 0;
+}
+
+ConverterWarmUp::ConverterWarmUp()
+    : _count(0),
+      _isRunning(false)
+{
+}
+
+ConverterWarmUp::~ConverterWarmUp()
+{
+    wait();
+}
+
+status_t ConverterWarmUp::start(const char* const* charsets, size_t count, bool inBackground)
+{
+    wait();
+    if (count > kMaxCharsets)
+        return BAD_VALUE;
+
+    if (!inBackground) {
+        UErrorCode status = U_ZERO_ERROR;
+        for (size_t i = 0; i < count && U_SUCCESS(status); i++)
+            ConverterCache::get(charsets[i], &status);
+        return U_SUCCESS(status) ? OK : NAME_NOT_FOUND;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        _charsets[i] = charsets[i];
+    _count = count;
+    if (pthread_create(&_thread, NULL, run, this) != 0)
+        return UNKNOWN_ERROR;
+    _isRunning = true;
+    return OK;
+}
+
+void ConverterWarmUp::wait()
+{
+    if (!_isRunning)
+        return;
+    pthread_join(_thread, NULL);
+    _isRunning = false;
+}
+
+// Loads the shared data only: a converter opened here couldn't be used
+// by another thread anyway.
+void* ConverterWarmUp::run(void* self)
+{
+    ConverterWarmUp* warmUp = static_cast<ConverterWarmUp*>(self);
+    for (size_t i = 0; i < warmUp->_count; i++) {
+        UErrorCode status = U_ZERO_ERROR;
+        UConverter* conv = ucnv_open(warmUp->_charsets[i], &status);
+        if (U_SUCCESS(status))
+            ucnv_close(conv);
+        else
+            LOGE("could not create UConverter for %s\n", warmUp->_charsets[i]);
+    }
+    return NULL;
+}
+
+}
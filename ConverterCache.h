@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONVERTER_CACHE_H
+#define CONVERTER_CACHE_H
+
+#include <pthread.h>
+#include <vector>
+
+#include <unicode/ucnv.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+// Per-thread cache of ICU converters keyed by charset name.
+//
+// ucnv_open() looks up the alias table and clones the shared converter
+// data each time, which is a large part of converting a short tag.
+// The cache opens each charset once per thread and hands out the same
+// converter, reset, on the following lookups.
+//
+// Converters returned by get() stay owned by the cache: never
+// ucnv_close() them, and don't pass them to another thread. They are
+// closed by releaseThreadCache() or when the owning thread exits.
+class ConverterCache {
+public:
+    // Returns the calling thread's converter for charset, or NULL with
+    // *status set if ICU can't open it.
+    static UConverter* get(const char* charset, UErrorCode* status);
+
+    // Closes every converter of the calling thread.
+    static void releaseThreadCache();
+
+    // Number of ucnv_open() calls made by the calling thread's cache.
+    static int openCount();
+
+private:
+    enum { kMaxNameLength = 32 };
+
+    struct Entry {
+        char name[kMaxNameLength];
+        UConverter* conv;
+    };
+
+    std::vector<Entry> _entries;
+    int _openCount;
+
+    ConverterCache() : _openCount(0) {}
+    ~ConverterCache();
+
+    UConverter* lookup(const char* charset, UErrorCode* status);
+
+    static ConverterCache* threadCache(bool create);
+    static void destroyThreadCache(void* cache);
+    static void createKey();
+};
+
+// Opens converters ahead of the first file that needs them.
+//
+// The first ucnv_open() of a charset in a process, or after
+// ucnv_flushCache(), loads and parses its converter data, which takes far
+// longer than converting a tag. Once loaded, ICU keeps the data shared
+// until it is flushed, and later opens only clone it.
+//
+// In the foreground the calling thread's ConverterCache opens each
+// charset, so nothing is left to open. In the background a thread opens
+// and closes each one, which loads the shared data for every thread, and
+// the caller goes on until wait().
+class ConverterWarmUp {
+public:
+    ConverterWarmUp();
+    // waits for a background warm-up.
+    ~ConverterWarmUp();
+
+    // charsets must stay valid until wait(). Waits for a previous
+    // background warm-up first. Fails if a charset can't be opened, in
+    // the foreground only.
+    status_t start(const char* const* charsets, size_t count, bool inBackground);
+
+    void wait();
+
+    bool isRunning() const { return _isRunning; }
+
+private:
+    enum { kMaxCharsets = 8 };
+
+    const char* _charsets[kMaxCharsets];
+    size_t _count;
+    pthread_t _thread;
+    bool _isRunning;
+
+    static void* run(void* self);
+
+    ConverterWarmUp(const ConverterWarmUp&);
+    ConverterWarmUp& operator=(const ConverterWarmUp&);
+};
+
+}
+
+#endif // CONVERTER_CACHE_H
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "DetectionCache.h"
+
+namespace android {
+
+DetectionCache::DetectionCache(size_t capacity)
+    : _size(0),
+      _head(-1),
+      _tail(-1)
+{
+    if (capacity == 0)
+        capacity = 1;
+    _entries.resize(capacity);
+
+    // keep chains short: at least twice as many buckets as entries.
+    size_t buckets = 1;
+    while (buckets < capacity * 2)
+        buckets <<= 1;
+    _buckets.resize(buckets, -1);
+
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+// 64 bit FNV-1a, seeded with the encoding.
+uint64_t DetectionCache::hash(uint32_t encoding, const char* bytes, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL ^ encoding;
+    const uint8_t* p = (const uint8_t*)bytes;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+int DetectionCache::find(uint32_t encoding, const char* bytes, size_t len, uint64_t h)
+{
+    for (int idx = _buckets[h & (_buckets.size() - 1)]; idx >= 0; idx = _entries[idx].chain) {
+        const Entry& e = _entries[idx];
+        if (e.hash == h && e.encoding == encoding && e.key.size() == len &&
+            (len == 0 || !memcmp(&e.key[0], bytes, len))) {
+            if (idx != _head) {
+                unlink(idx);
+                pushFront(idx);
+            }
+            return idx;
+        }
+    }
+    return -1;
+}
+
+void DetectionCache::unlink(int idx)
+{
+    Entry& e = _entries[idx];
+    if (e.prev >= 0)
+        _entries[e.prev].next = e.next;
+    else
+        _head = e.next;
+    if (e.next >= 0)
+        _entries[e.next].prev = e.prev;
+    else
+        _tail = e.prev;
+}
+
+void DetectionCache::pushFront(int idx)
+{
+    Entry& e = _entries[idx];
+    e.prev = -1;
+    e.next = _head;
+    if (_head >= 0)
+        _entries[_head].prev = idx;
+    _head = idx;
+    if (_tail < 0)
+        _tail = idx;
+}
+
+void DetectionCache::removeFromBucket(int idx)
+{
+    int* link = &_buckets[_entries[idx].hash & (_buckets.size() - 1)];
+    while (*link != idx)
+        link = &_entries[*link].chain;
+    *link = _entries[idx].chain;
+}
+
+int DetectionCache::insert(uint32_t encoding, const char* bytes, size_t len, uint64_t h)
+{
+    int idx;
+    if (_size < _entries.size()) {
+        idx = _size++;
+    } else {
+        // reuse the least recently used entry, and its buffers.
+        idx = _tail;
+        unlink(idx);
+        removeFromBucket(idx);
+        _stats.evictions++;
+    }
+
+    Entry& e = _entries[idx];
+    e.hash = h;
+    e.encoding = encoding;
+    e.hasConverted = false;
+    e.key.assign(bytes, bytes + len);
+    e.converted.clear();
+
+    int& bucket = _buckets[h & (_buckets.size() - 1)];
+    e.chain = bucket;
+    bucket = idx;
+    pushFront(idx);
+    return idx;
+}
+
+bool DetectionCache::lookupScan(uint32_t encoding, const char* bytes, size_t len,
+                                NativeEncodingScan* scan)
+{
+    int idx = find(encoding, bytes, len, hash(encoding, bytes, len));
+    if (idx < 0) {
+        _stats.misses++;
+        return false;
+    }
+    _stats.hits++;
+    *scan = _entries[idx].scan;
+    return true;
+}
+
+void DetectionCache::storeScan(uint32_t encoding, const char* bytes, size_t len,
+                               const NativeEncodingScan& scan)
+{
+    uint64_t h = hash(encoding, bytes, len);
+    int idx = find(encoding, bytes, len, h);
+    if (idx < 0)
+        idx = insert(encoding, bytes, len, h);
+    _entries[idx].scan = scan;
+}
+
+const char* DetectionCache::lookupConverted(uint32_t encoding, const char* bytes, size_t len)
+{
+    int idx = find(encoding, bytes, len, hash(encoding, bytes, len));
+    if (idx < 0 || !_entries[idx].hasConverted) {
+        _stats.conversionMisses++;
+        return NULL;
+    }
+    _stats.conversionHits++;
+    return &_entries[idx].converted[0];
+}
+
+void DetectionCache::storeConverted(uint32_t encoding, const char* bytes, size_t len,
+                                    const char* utf8, size_t utf8Len)
+{
+    uint64_t h = hash(encoding, bytes, len);
+    int idx = find(encoding, bytes, len, h);
+    if (idx < 0) {
+        // evicted since its scan was stored; the scan is redone on a miss.
+        idx = insert(encoding, bytes, len, h);
+        _entries[idx].scan = scanNativeEncodings(bytes, len);
+    }
+    Entry& e = _entries[idx];
+    e.converted.assign(utf8, utf8 + utf8Len);
+    e.converted.push_back(0);
+    e.hasConverted = true;
+}
+
+void DetectionCache::clear()
+{
+    for (size_t i = 0; i < _buckets.size(); i++)
+        _buckets[i] = -1;
+    _size = 0;
+    _head = -1;
+    _tail = -1;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+}
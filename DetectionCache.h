@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DETECTION_CACHE_H
+#define DETECTION_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "NativeEncodingDetector.h"
+
+namespace android {
+
+// Bounded LRU memo of detection and conversion results across files.
+//
+// The artist, album and album artist of every track of an album are the
+// same bytes, so a scan detects and converts them over and over. Entries
+// are keyed by the locale encoding and the narrowed native bytes of a
+// value, and hold its NativeEncodingScan and, once it has been
+// converted, its UTF-8. A cache is used by one thread at a time.
+class DetectionCache {
+public:
+    struct Stats {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t conversionHits;
+        uint32_t conversionMisses;
+        uint32_t evictions;
+    };
+
+    explicit DetectionCache(size_t capacity);
+
+    // Returns true and fills *scan if bytes are cached for encoding.
+    bool lookupScan(uint32_t encoding, const char* bytes, size_t len,
+                    NativeEncodingScan* scan);
+    void storeScan(uint32_t encoding, const char* bytes, size_t len,
+                   const NativeEncodingScan& scan);
+
+    // Returns the cached zero terminated UTF-8 of bytes, or NULL. It is
+    // valid until the next call that stores into the cache.
+    const char* lookupConverted(uint32_t encoding, const char* bytes, size_t len);
+    void storeConverted(uint32_t encoding, const char* bytes, size_t len,
+                        const char* utf8, size_t utf8Len);
+
+    void clear();
+
+    const Stats& stats() const { return _stats; }
+    size_t size() const { return _size; }
+    size_t capacity() const { return _entries.size(); }
+
+    static uint64_t hash(uint32_t encoding, const char* bytes, size_t len);
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint32_t encoding;
+        NativeEncodingScan scan;
+        bool hasConverted;
+        std::vector<char> key;
+        std::vector<char> converted;
+        int prev;       // LRU list, most recent first
+        int next;
+        int chain;      // next entry of the same bucket
+    };
+
+    std::vector<Entry> _entries;
+    std::vector<int> _buckets;
+    size_t _size;
+    int _head;
+    int _tail;
+    Stats _stats;
+
+    int find(uint32_t encoding, const char* bytes, size_t len, uint64_t h);
+    int insert(uint32_t encoding, const char* bytes, size_t len, uint64_t h);
+    void unlink(int idx);
+    void pushFront(int idx);
+    void removeFromBucket(int idx);
+};
+
+}
+
+#endif // DETECTION_CACHE_H
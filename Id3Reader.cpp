@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Id3Reader"
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Id3Reader.h"
+
+namespace android {
+
+static const size_t kId3v2HeaderSize = 10;
+static const size_t kId3v1Size = 128;
+
+// ID3v2.2 text frames and their ID3v2.3 IDs; the others are skipped.
+static const char* const kId3v22Frames[][2] = {
+    { "TT2", "TIT2" }, { "TP1", "TPE1" }, { "TP2", "TPE2" }, { "TAL", "TALB" },
+    { "TYE", "TYER" }, { "TCM", "TCOM" }, { "TCO", "TCON" }, { "TRK", "TRCK" },
+    { "TPA", "TPOS" }, { "TCP", "TCMP" },
+};
+
+static uint32_t syncsafe(const uint8_t* p)
+{
+    return (p[0] << 21) | (p[1] << 14) | (p[2] << 7) | p[3];
+}
+
+static uint32_t bigEndian(const uint8_t* p, size_t n)
+{
+    uint32_t v = 0;
+    for (size_t i = 0; i < n; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+Id3Reader::Id3Reader()
+    : _base(NULL),
+      _size(0)
+{
+}
+
+Id3Reader::~Id3Reader()
+{
+    close();
+}
+
+status_t Id3Reader::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        LOGE("can't open %s: %s\n", path, strerror(errno));
+        return NAME_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        ::close(fd);
+        return UNKNOWN_ERROR;
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        return OK;      // nothing to map, and no tags
+    }
+
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        LOGE("can't mmap %s: %s\n", path, strerror(errno));
+        return NO_MEMORY;
+    }
+    _base = (const char*)base;
+    _size = st.st_size;
+    return OK;
+}
+
+void Id3Reader::close()
+{
+    if (_base)
+        munmap((void*)_base, _size);
+    _base = NULL;
+    _size = 0;
+}
+
+status_t Id3Reader::parse(Id3TextHandler* handler) const
+{
+    return parse(_base, _size, handler);
+}
+
+status_t Id3Reader::parse(const char* data, size_t size, Id3TextHandler* handler)
+{
+    bool found = false;
+    status_t result = parseId3v2((const uint8_t*)data, size, handler, &found);
+    if (result != OK || found)
+        return result;
+    return parseId3v1((const uint8_t*)data, size, handler);
+}
+
+// *found tells whether the file has an ID3v2 tag this can read.
+status_t Id3Reader::parseId3v2(const uint8_t* data, size_t size, Id3TextHandler* handler,
+                               bool* found)
+{
+    if (size < kId3v2HeaderSize || memcmp(data, "ID3", 3) != 0)
+        return OK;
+    uint8_t version = data[3];
+    uint8_t flags = data[5];
+    if (version < 2 || version > 4 || (data[6] | data[7] | data[8] | data[9]) & 0x80)
+        return OK;
+    if (version < 4 && (flags & 0x80))
+        return OK;      // unsynchronised as a whole
+
+    size_t end = kId3v2HeaderSize + syncsafe(data + 6);
+    if (end > size)
+        end = size;
+    size_t pos = kId3v2HeaderSize;
+
+    if (version >= 3 && (flags & 0x40)) {
+        if (pos + 4 > end)
+            return OK;
+        // the size of the extended header counts itself in 2.4 only
+        size_t extended = version == 4 ? syncsafe(data + pos) : 4 + bigEndian(data + pos, 4);
+        pos += extended;
+    }
+    *found = true;
+
+    size_t idLength = version == 2 ? 3 : 4;
+    size_t headerSize = version == 2 ? 6 : 10;
+    while (pos + headerSize <= end) {
+        const uint8_t* frame = data + pos;
+        if (frame[0] == 0)
+            break;      // padding
+        size_t frameSize;
+        uint16_t frameFlags = 0;
+        if (version == 2) {
+            frameSize = bigEndian(frame + 3, 3);
+        } else {
+            frameSize = version == 4 ? syncsafe(frame + 4) : bigEndian(frame + 4, 4);
+            frameFlags = bigEndian(frame + 8, 2);
+        }
+        if (frameSize > end - pos - headerSize)
+            break;
+        pos += headerSize + frameSize;
+
+        // compressed, encrypted, unsynchronised or with a data length
+        uint16_t unreadable = version == 4 ? 0x000F : 0x00C0;
+        if (frame[0] != 'T' || frameSize < 1 || (frameFlags & unreadable))
+            continue;
+
+        char frameId[5];
+        if (version == 2) {
+            const char* mapped = NULL;
+            for (size_t i = 0; i < sizeof(kId3v22Frames)/sizeof(kId3v22Frames[0]); i++) {
+                if (!memcmp(frame, kId3v22Frames[i][0], 3))
+                    mapped = kId3v22Frames[i][1];
+            }
+            if (!mapped)
+                continue;
+            memcpy(frameId, mapped, 5);
+        } else {
+            memcpy(frameId, frame, idLength);
+            frameId[idLength] = 0;
+            if (!strcmp(frameId, "TXXX"))
+                continue;
+        }
+
+        uint8_t encoding = frame[headerSize];
+        if (encoding > kId3Utf8)
+            continue;
+        status_t result = handler->handleId3Text(frameId, (Id3TextEncoding)encoding,
+                                                 (const char*)frame + headerSize + 1,
+                                                 frameSize - 1);
+        if (result != OK)
+            return result;
+    }
+    return OK;
+}
+
+// title, artist, album and year of an ID3v1 tag, padded with zeros or
+// spaces.
+status_t Id3Reader::parseId3v1(const uint8_t* data, size_t size, Id3TextHandler* handler)
+{
+    static const struct {
+        const char* frameId;
+        size_t offset;
+        size_t length;
+    } fields[] = {
+        { "TIT2", 3, 30 }, { "TPE1", 33, 30 }, { "TALB", 63, 30 }, { "TYER", 93, 4 },
+    };
+
+    if (size < kId3v1Size)
+        return OK;
+    const uint8_t* tag = data + size - kId3v1Size;
+    if (memcmp(tag, "TAG", 3) != 0)
+        return OK;
+
+    for (size_t i = 0; i < sizeof(fields)/sizeof(fields[0]); i++) {
+        const char* text = (const char*)tag + fields[i].offset;
+        const char* zero = (const char*)memchr(text, 0, fields[i].length);
+        size_t length = zero ? zero - text : fields[i].length;
+        while (length > 0 && text[length - 1] == ' ')
+            length--;
+        if (length == 0)
+            continue;
+        status_t result = handler->handleId3Text(fields[i].frameId, kId3Latin1, text, length);
+        if (result != OK)
+            return result;
+    }
+    return OK;
+}
+
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ID3_READER_H
+#define ID3_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+// Text encoding byte of an ID3v2 text frame.
+enum Id3TextEncoding {
+    kId3Latin1 = 0,         // ISO-8859-1, in practice any single or
+                            // multi byte native encoding
+    kId3Utf16 = 1,          // with a BOM
+    kId3Utf16BigEndian = 2,
+    kId3Utf8 = 3,
+};
+
+// Gets the text of the tags Id3Reader finds.
+class Id3TextHandler {
+public:
+    virtual ~Id3TextHandler() {}
+    // frameId is the zero terminated ID3v2.3 frame ID, with ID3v2.2 IDs
+    // and ID3v1 fields mapped to it. text points into the file and is
+    // not zero terminated; it ends with the frame, and may hold more
+    // than one string separated by zeros.
+    virtual status_t handleId3Text(const char* frameId, Id3TextEncoding encoding,
+                                   const char* text, size_t length) = 0;
+};
+
+// Read-only mmap() of an audio file, for the text of its ID3 tags.
+//
+// Only the pages of the tags are touched: the ID3v2 tag at the start of
+// the file and the 128 bytes of an ID3v1 tag at its end. ID3v2.2 to 2.4
+// are read, but not frames that are compressed, encrypted or
+// unsynchronised, nor a whole ID3v2.3 tag that is unsynchronised. As
+// MP3 extractors do, the ID3v1 tag is only read without a usable ID3v2
+// one.
+class Id3Reader {
+public:
+    Id3Reader();
+    ~Id3Reader();
+
+    status_t open(const char* path);
+    void close();
+
+    bool isOpen() const { return _base != NULL; }
+    size_t size() const { return _size; }
+
+    // Hands every text frame of the file to handler, stopping at the
+    // first error it returns.
+    status_t parse(Id3TextHandler* handler) const;
+
+    // The same on a file already in memory.
+    static status_t parse(const char* data, size_t size, Id3TextHandler* handler);
+
+private:
+    const char* _base;
+    size_t _size;
+
+    static status_t parseId3v2(const uint8_t* data, size_t size, Id3TextHandler* handler,
+                               bool* found);
+    static status_t parseId3v1(const uint8_t* data, size_t size, Id3TextHandler* handler);
+
+    Id3Reader(const Id3Reader&);
+    Id3Reader& operator=(const Id3Reader&);
+};
+
+}
+
+#endif // ID3_READER_H
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "Latin1Utf8.h"
+
+namespace android {
+
+// 0x80-0x9F of windows-1252; the rest is Latin-1.
+static const uint16_t kWindows1252High[32] = {
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+};
+
+// Copies the ASCII bytes of src from *i on to *out, and moves both past
+// them. A block that isn't all ASCII is stored whole, which the caller's
+// output bound leaves room for: at least two bytes per input byte left,
+// and the non-ASCII part gets overwritten.
+static inline void copyAscii(const uint8_t* src, size_t len, size_t* i, uint8_t** out)
+{
+    size_t k = *i;
+    uint8_t* o = *out;
+
+#if defined(__AVX2__)
+    for (; k + 32 <= len; k += 32, o += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + k));
+        _mm256_storeu_si256((__m256i*)o, v);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(v);
+        if (mask) {
+            size_t n = __builtin_ctz(mask);
+            *i = k + n;
+            *out = o + n;
+            return;
+        }
+    }
+#elif defined(__SSE2__)
+    for (; k + 16 <= len; k += 16, o += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + k));
+        _mm_storeu_si128((__m128i*)o, v);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(v);
+        if (mask) {
+            size_t n = __builtin_ctz(mask);
+            *i = k + n;
+            *out = o + n;
+            return;
+        }
+    }
+#elif defined(__ARM_NEON__)
+    for (; k + 16 <= len; k += 16, o += 16) {
+        uint8x16_t v = vld1q_u8(src + k);
+        uint8x8_t m = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+        if (vget_lane_u64(vreinterpret_u64_u8(m), 0) & 0x8080808080808080ULL)
+            break;      // the loops below find the byte
+        vst1q_u8(o, v);
+    }
+#endif
+
+    for (; k + 4 <= len; k += 4, o += 4) {
+        uint32_t word;
+        memcpy(&word, src + k, 4);
+        if (word & 0x80808080)
+            break;
+        memcpy(o, &word, 4);
+    }
+    for (; k < len && src[k] < 0x80; k++)
+        *o++ = src[k];
+
+    *i = k;
+    *out = o;
+}
+
+char* latin1ToUtf8(const char* src, size_t len, char* out)
+{
+    const uint8_t* p = (const uint8_t*)src;
+    uint8_t* o = (uint8_t*)out;
+    size_t i = 0;
+
+    while (i < len) {
+        copyAscii(p, len, &i, &o);
+        for (; i < len && p[i] >= 0x80; i++) {
+            *o++ = 0xC0 | (p[i] >> 6);
+            *o++ = 0x80 | (p[i] & 0x3F);
+        }
+    }
+    return (char*)o;
+}
+
+char* windows1252ToUtf8(const char* src, size_t len, char* out)
+{
+    const uint8_t* p = (const uint8_t*)src;
+    uint8_t* o = (uint8_t*)out;
+    size_t i = 0;
+
+    while (i < len) {
+        copyAscii(p, len, &i, &o);
+        for (; i < len && p[i] >= 0x80; i++) {
+            uint32_t c = p[i];
+            if (c < 0xA0)
+                c = kWindows1252High[c - 0x80];
+            if (c < 0x800) {
+                *o++ = 0xC0 | (c >> 6);
+                *o++ = 0x80 | (c & 0x3F);
+            } else {
+                *o++ = 0xE0 | (c >> 12);
+                *o++ = 0x80 | ((c >> 6) & 0x3F);
+                *o++ = 0x80 | (c & 0x3F);
+            }
+        }
+    }
+    return (char*)o;
+}
+
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LATIN1_UTF8_H
+#define LATIN1_UTF8_H
+
+#include <stddef.h>
+
+namespace android {
+
+// Single byte to UTF-8 conversion of tag values, the same as ICU's
+// "iso_8859_1" and "windows-1252" converters give. Runs of ASCII are
+// copied 16 or 32 bytes at a time with SSE2, AVX2 or NEON when the
+// target has it, a word at a time otherwise.
+//
+// Neither writes a terminating zero; both return the end of the output.
+
+// out must hold 2 * len bytes.
+char* latin1ToUtf8(const char* src, size_t len, char* out);
+
+// out must hold 3 * len bytes. Bytes windows-1252 leaves undefined
+// become the C1 controls, as with ICU.
+char* windows1252ToUtf8(const char* src, size_t len, char* out);
+
+}
+
+#endif // LATIN1_UTF8_H
@@ -0,0 +1,1073 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MediaScannerClient_benchmark"
+#include <utils/Log.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "AlbumEncodingVote.h"
+#include "BenchmarkStats.h"
+#include "DetectionCache.h"
+#include "SyntheticMp3.h"
+#include "Latin1Utf8.h"
+#include "NativeEncodingDetector.h"
+#include "ScanDriver.h"
+#include "ScanPipeline.h"
+#include "TesteeCorpus.h"
+#include "TestableMediaScannerClient.h"
+#include "testee.h"
+
+namespace android {
+
+struct bench_table {
+    const char* name;
+    str_pair* table;
+    unsigned int size;
+    bool is_native;
+};
+
+#define BENCH_TABLE(t, native) { #t, t, sizeof(t)/sizeof(str_pair), native }
+
+static bench_table bench_tables[] = {
+    BENCH_TABLE(strs_utf_8, false),
+    BENCH_TABLE(strs_windows_1252, true),
+    BENCH_TABLE(strs_EUC_KR, true),
+    BENCH_TABLE(strs_SHIFT_JIS, true),
+    BENCH_TABLE(strs_GB2312, true),
+    BENCH_TABLE(strs_Big5, true),
+};
+
+// NULL keeps the client's default locale, which never needs detection.
+static const char* bench_locales[] = { NULL, "ko", "ja", "zh", "zh_CN" };
+
+static unsigned int tableBytes(const bench_table& t)
+{
+    unsigned int bytes = 0;
+    for (unsigned int i = 0; i < t.size; i++)
+        bytes += strlen(t.table[i].native);
+    return bytes;
+}
+
+// One file per iteration: every string of the table is a tag of the file.
+// The whole beginFile()..endFile() is timed for the throughput numbers,
+// endFile() alone for the latency percentiles.
+static void benchTable(const bench_table& t, const char* locale, int iterations)
+{
+    TestableMediaScannerClient* client = new TestableMediaScannerClient();
+    if (locale)
+        client->setLocale(locale);
+
+    BenchmarkStats stats;
+    stats.reserve(iterations);
+
+    client->initResults();
+    for (int iter = 0; iter < iterations; iter++) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        client->beginFile();
+        for (unsigned int i = 0; i < t.size; i++) {
+            if (t.is_native)
+                client->addNativeStringTagWithIdx(i, t.table[i].native);
+            else
+                client->addStringTagWithIdx(i, t.table[i].native);
+        }
+        nsecs_t endFileStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        client->endFile();
+        nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC);
+
+        stats.addSample(end - endFileStart);
+        stats.addTotal(end - start);
+    }
+    client->releaseResults();
+
+    double tags = (double)t.size * iterations;
+    double bytes = (double)tableBytes(t) * iterations;
+    printf("%-18s %-6s %10.0f tags/s %8.2f MB/s  endFile p50 %8.2f us  p99 %8.2f us\n",
+           t.name, locale ? locale : "-",
+           stats.rate(tags), stats.rate(bytes) / (1024 * 1024),
+           nsToUs(stats.percentile(50)), nsToUs(stats.percentile(99)));
+
+    delete client;
+}
+
+// What addNativeStringTagWithIdx() did before ConverterCache: open both
+// converters for every tag. Kept here as the baseline of benchConverterReuse().
+static bool addNativeStringTagReopening(TestableMediaScannerClient* client,
+                                        int sortingIdx, const char* value,
+                                        std::vector<char>& buffer)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter* conv = ucnv_open("iso_8859_1", &status);
+    if (U_FAILURE(status))
+        return false;
+    UConverter* utf8Conv = ucnv_open("UTF-8", &status);
+    if (U_FAILURE(status)) {
+        ucnv_close(conv);
+        return false;
+    }
+
+    const char* src = value;
+    int len = strlen(src);
+    int targetLen = len * 3 + 1;
+    buffer.resize(targetLen);
+    char* target = &buffer[0];
+    ucnv_convertEx(utf8Conv, conv, &target, target + targetLen,
+                   &src, src + len, NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
+    ucnv_close(conv);
+    ucnv_close(utf8Conv);
+    if (U_FAILURE(status))
+        return false;
+    *target = 0;
+
+    return client->addStringTagWithIdx(sortingIdx, &buffer[0]);
+}
+
+// Per-tag cost of the native ingest path as the number of tags per file
+// grows, with converters reopened per tag against addNativeStringTagWithIdx(),
+// which took them from ConverterCache and now uses latin1ToUtf8().
+static void benchConverterReuse(int iterations)
+{
+    static const int tagCounts[] = { 1, 10, 100, 1000 };
+    const bench_table& t = bench_tables[1];    // strs_windows_1252
+    std::vector<char> buffer;
+
+    for (unsigned int c = 0; c < sizeof(tagCounts)/sizeof(tagCounts[0]); c++) {
+        int tagCount = tagCounts[c];
+        int files = iterations * 10 / tagCount + 1;
+        nsecs_t elapsed[2];
+
+        for (int cached = 0; cached < 2; cached++) {
+            TestableMediaScannerClient* client = new TestableMediaScannerClient();
+            client->initResults();
+            nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+            for (int f = 0; f < files; f++) {
+                client->beginFile();
+                for (int i = 0; i < tagCount; i++) {
+                    const char* value = t.table[i % t.size].native;
+                    if (cached)
+                        client->addNativeStringTagWithIdx(i, value);
+                    else
+                        addNativeStringTagReopening(client, i, value, buffer);
+                }
+                client->endFile();
+            }
+            elapsed[cached] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+            client->releaseResults();
+            delete client;
+        }
+
+        double tags = (double)tagCount * files;
+        printf("converter reuse    %5d tags/file  reopen %8.0f ns/tag  cached %8.0f ns/tag\n",
+               tagCount, elapsed[0] / tags, elapsed[1] / tags);
+    }
+}
+
+// ICU's converter from charset, as toLatin1Utf8() used to convert.
+static char* icuToUtf8(const char* charset, const char* src, size_t len, char* out)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter* conv = ConverterCache::get(charset, &status);
+    UConverter* utf8Conv = ConverterCache::get("UTF-8", &status);
+    ucnv_convertEx(utf8Conv, conv, &out, out + len * 3, &src, src + len,
+                   NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
+    return out;
+}
+
+// Latin-1 and windows-1252 to UTF-8 by ICU against latin1ToUtf8() and
+// windows1252ToUtf8(), on the windows-1252 table, on ASCII with an
+// accent every 32 bytes and on bytes that are all above 0x7F.
+static void benchLatin1(int iterations)
+{
+    std::vector<std::string> inputs[3];
+    static const char* inputNames[] = { "strs_windows_1252", "ascii+accents", "high bytes" };
+    const bench_table& t = bench_tables[1];    // strs_windows_1252
+    for (unsigned int i = 0; i < t.size; i++)
+        inputs[0].push_back(t.table[i].native);
+    for (int i = 0; i < 50; i++) {
+        std::string ascii, high;
+        for (int k = 0; k < 40 + i; k++) {
+            ascii += k % 32 == 31 ? '\xE9' : 'a' + k % 26;
+            high += (char)(0xA0 + (k + i) % 0x60);
+        }
+        inputs[1].push_back(ascii);
+        inputs[2].push_back(high);
+    }
+
+    std::vector<char> out;
+    for (int in = 0; in < 3; in++) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < inputs[in].size(); i++) {
+            bytes += inputs[in][i].size();
+            if (out.size() < inputs[in][i].size() * 3)
+                out.resize(inputs[in][i].size() * 3);
+        }
+        for (int charset = 0; charset < 2; charset++) {
+            nsecs_t elapsed[2];
+            for (int kernel = 0; kernel < 2; kernel++) {
+                nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+                for (int n = 0; n < iterations; n++) {
+                    for (size_t i = 0; i < inputs[in].size(); i++) {
+                        const std::string& s = inputs[in][i];
+                        if (!kernel)
+                            icuToUtf8(charset ? "windows-1252" : "iso_8859_1",
+                                      s.data(), s.size(), &out[0]);
+                        else if (charset)
+                            windows1252ToUtf8(s.data(), s.size(), &out[0]);
+                        else
+                            latin1ToUtf8(s.data(), s.size(), &out[0]);
+                    }
+                }
+                elapsed[kernel] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+            }
+            double mb = (double)bytes * iterations / (1024 * 1024);
+            printf("latin1 to utf-8    %-18s %-12s icu %8.1f MB/s  kernel %8.1f MB/s  x%.2f\n",
+                   inputNames[in], charset ? "windows-1252" : "iso_8859_1",
+                   elapsed[0] > 0 ? mb * 1e9 / elapsed[0] : 0,
+                   elapsed[1] > 0 ? mb * 1e9 / elapsed[1] : 0,
+                   elapsed[1] > 0 ? (double)elapsed[0] / elapsed[1] : 0);
+        }
+    }
+}
+
+// The tables' UTF-8 as UTF-16LE with a BOM, the way ID3v2 frames of
+// text encoding 1 usually have it.
+static std::vector<std::string> utf16Values(const bench_table& t)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter* conv = ConverterCache::get("UTF-16LE", &status);
+    UConverter* utf8Conv = ConverterCache::get("UTF-8", &status);
+    std::vector<std::string> values;
+    std::vector<char> out;
+    for (unsigned int i = 0; i < t.size; i++) {
+        const char* src = t.table[i].utf_8;
+        size_t len = strlen(src);
+        out.resize(len * 2 + 2);
+        char* target = &out[0];
+        ucnv_convertEx(conv, utf8Conv, &target, target + out.size(), &src, src + len,
+                       NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
+        values.push_back(std::string("\xFF\xFE") + std::string(&out[0], target - &out[0]));
+    }
+    return values;
+}
+
+// UTF-16 frames converted by ICU's "UTF-16" converter and added as
+// UTF-8, which goes through detection, against addUtf16StringTagWithIdx();
+// under ko, through MediaScannerClient and the TagConverter.
+static void benchUtf16(int iterations)
+{
+    for (unsigned int t = 0; t < 2; t++) {     // strs_utf_8, strs_windows_1252
+        std::vector<std::string> values = utf16Values(bench_tables[t]);
+        size_t bytes = 0;
+        for (size_t i = 0; i < values.size(); i++)
+            bytes += values[i].size();
+
+        for (int converter = 0; converter < 2; converter++) {
+            nsecs_t elapsed[2];
+            for (int direct = 0; direct < 2; direct++) {
+                TestableMediaScannerClient* client = new TestableMediaScannerClient();
+                client->setLocale("ko");
+                client->setTagConverterEnabled(converter);
+                client->initResults();
+                std::vector<char> buffer;
+                UErrorCode status = U_ZERO_ERROR;
+                UConverter* conv = ConverterCache::get("UTF-16", &status);
+                UConverter* utf8Conv = ConverterCache::get("UTF-8", &status);
+
+                nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+                for (int f = 0; f < iterations; f++) {
+                    client->beginFile();
+                    for (size_t i = 0; i < values.size(); i++) {
+                        const std::string& v = values[i];
+                        if (direct) {
+                            client->addUtf16StringTagWithIdx(i, v.data(), v.size());
+                            continue;
+                        }
+                        buffer.resize(v.size() / 2 * 3 + 1);
+                        char* target = &buffer[0];
+                        const char* src = v.data();
+                        ucnv_convertEx(utf8Conv, conv, &target, target + buffer.size(),
+                                       &src, src + v.size(), NULL, NULL, NULL, NULL,
+                                       TRUE, TRUE, &status);
+                        *target = 0;
+                        client->addStringTagWithIdx(i, &buffer[0]);
+                    }
+                    client->endFile();
+                }
+                elapsed[direct] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+                client->releaseResults();
+                delete client;
+            }
+            double mb = (double)bytes * iterations / (1024 * 1024);
+            printf("utf-16             %-18s %-9s icu+detect %8.1f MB/s  direct %8.1f MB/s  x%.2f\n",
+                   bench_tables[t].name, converter ? "converter" : "client",
+                   elapsed[0] > 0 ? mb * 1e9 / elapsed[0] : 0,
+                   elapsed[1] > 0 ? mb * 1e9 / elapsed[1] : 0,
+                   elapsed[1] > 0 ? (double)elapsed[0] / elapsed[1] : 0);
+        }
+    }
+}
+
+static nsecs_t timeFiles(TestableMediaScannerClient* client, const bench_table& t, int files)
+{
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int f = 0; f < files; f++) {
+        client->beginFile();
+        for (unsigned int i = 0; i < t.size; i++) {
+            if (t.is_native)
+                client->addNativeStringTagWithIdx(i, t.table[i].native);
+            else
+                client->addStringTagWithIdx(i, t.table[i].native);
+        }
+        client->endFile();
+    }
+    return systemTime(SYSTEM_TIME_MONOTONIC) - start;
+}
+
+// Whole-file time with and without the ASCII/UTF-8 prescreen, under the
+// locales that make MediaScannerClient detect.
+static void benchPrescreen(int iterations)
+{
+    for (unsigned int l = 1; l < sizeof(bench_locales)/sizeof(bench_locales[0]); l++) {
+        for (unsigned int t = 0; t < sizeof(bench_tables)/sizeof(bench_tables[0]); t++) {
+            nsecs_t elapsed[2];
+            for (int enabled = 0; enabled < 2; enabled++) {
+                TestableMediaScannerClient* client = new TestableMediaScannerClient();
+                client->setLocale(bench_locales[l]);
+                client->setPrescreenEnabled(enabled);
+                client->initResults();
+                elapsed[enabled] = timeFiles(client, bench_tables[t], iterations);
+                client->releaseResults();
+                delete client;
+            }
+            printf("prescreen          %-18s %-6s off %8.2f us/file  on %8.2f us/file  x%.2f\n",
+                   bench_tables[t].name, bench_locales[l],
+                   nsToUs(elapsed[0] / iterations), nsToUs(elapsed[1] / iterations),
+                   elapsed[1] > 0 ? (double)elapsed[0] / elapsed[1] : 0);
+        }
+    }
+}
+
+// The TagConverter delivering to handleStringTag(), which copies every
+// value, against handleStringTagView(), which keeps views into the
+// converter's arena; each table under the locale that detects it.
+static void benchTagView(int iterations)
+{
+    static const char* tableLocales[] = { "ko", "ko", "ko", "ja", "zh_CN", "zh" };
+
+    for (unsigned int t = 0; t < sizeof(bench_tables)/sizeof(bench_tables[0]); t++) {
+        nsecs_t elapsed[2];
+        for (int enabled = 0; enabled < 2; enabled++) {
+            TestableMediaScannerClient* client = new TestableMediaScannerClient();
+            client->setLocale(tableLocales[t]);
+            client->setTagConverterEnabled(true);
+            client->setTagViewEnabled(enabled);
+            client->initResults();
+            elapsed[enabled] = timeFiles(client, bench_tables[t], iterations);
+            client->releaseResults();
+            delete client;
+        }
+        printf("tag view           %-18s %-6s copy %8.2f us/file  view %8.2f us/file  x%.2f\n",
+               bench_tables[t].name, tableLocales[t],
+               nsToUs(elapsed[0] / iterations), nsToUs(elapsed[1] / iterations),
+               elapsed[1] > 0 ? (double)elapsed[0] / elapsed[1] : 0);
+    }
+}
+
+// The TagConverter given a file's tags one by one, against all at once
+// by addStringTagsWithIdx(); each table under the locale that detects it.
+static void benchBatch(int iterations)
+{
+    static const char* tableLocales[] = { "ko", "ko", "ko", "ja", "zh_CN", "zh" };
+
+    for (unsigned int t = 0; t < sizeof(bench_tables)/sizeof(bench_tables[0]); t++) {
+        const bench_table& table = bench_tables[t];
+        std::vector<const char*> values;
+        for (unsigned int i = 0; i < table.size; i++)
+            values.push_back(table.table[i].native);
+
+        TestableMediaScannerClient* client = new TestableMediaScannerClient();
+        client->setLocale(tableLocales[t]);
+        client->setTagConverterEnabled(true);
+        client->initResults();
+
+        nsecs_t perTag = timeFiles(client, table, iterations);
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int f = 0; f < iterations; f++) {
+            client->beginFile();
+            client->addStringTagsWithIdx(&values[0], table.size, table.is_native);
+            client->endFile();
+        }
+        nsecs_t batched = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+        client->releaseResults();
+        delete client;
+
+        printf("batch              %-18s %-6s per tag %8.2f us/file  batched %8.2f us/file  x%.2f\n",
+               table.name, tableLocales[t],
+               nsToUs(perTag / iterations), nsToUs(batched / iterations),
+               batched > 0 ? (double)perTag / batched : 0);
+    }
+}
+
+// Files read back the way a quick rescan does, only the first few tags,
+// and whole: the TagConverter converting every value in endFile(), and
+// converting lazily on getResult(). Each table under the locale that
+// detects it.
+static void benchLazy(int iterations)
+{
+    static const char* tableLocales[] = { "ko", "ko", "ko", "ja", "zh_CN", "zh" };
+    const int readCounts[] = { 3, -1 };
+
+    for (unsigned int t = 1; t < sizeof(bench_tables)/sizeof(bench_tables[0]); t++) {
+        const bench_table& table = bench_tables[t];
+        for (int r = 0; r < 2; r++) {
+            int reads = readCounts[r] < 0 ? (int)table.size : readCounts[r];
+            nsecs_t elapsed[2];
+            for (int lazy = 0; lazy < 2; lazy++) {
+                TestableMediaScannerClient* client = new TestableMediaScannerClient();
+                client->setLocale(tableLocales[t]);
+                client->setTagConverterEnabled(true);
+                client->setTagViewEnabled(true);
+                client->setLazyConversionEnabled(lazy);
+                client->initResults();
+
+                size_t bytes = 0;
+                nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+                for (int f = 0; f < iterations; f++) {
+                    client->beginFile();
+                    for (unsigned int i = 0; i < table.size; i++)
+                        client->addNativeStringTagWithIdx(i, table.table[i].native);
+                    client->endFile();
+                    for (int i = 0; i < reads; i++)
+                        bytes += strlen(client->getResult(i));
+                }
+                elapsed[lazy] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+                if (bytes == 0)
+                    printf("lazy: nothing read\n");
+
+                client->releaseResults();
+                delete client;
+            }
+            printf("lazy conversion    %-18s %-6s %3d of %3u tags  eager %8.2f us/file  "
+                   "lazy %8.2f us/file  x%.2f\n",
+                   table.name, tableLocales[t], reads, table.size,
+                   nsToUs(elapsed[0] / iterations), nsToUs(elapsed[1] / iterations),
+                   elapsed[1] > 0 ? (double)elapsed[0] / elapsed[1] : 0);
+        }
+    }
+}
+
+// Whether bytes are well formed in charset, the way detection costs with
+// one ICU round trip per candidate encoding.
+static bool isWellFormedIn(const char* charset, const char* bytes, size_t len,
+                           std::vector<UChar>& buffer)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter* conv = ConverterCache::get(charset, &status);
+    if (U_FAILURE(status))
+        return false;
+    ucnv_setToUCallBack(conv, UCNV_TO_U_CALLBACK_STOP, NULL, NULL, NULL, &status);
+    buffer.resize(len + 1);
+    ucnv_toUChars(conv, &buffer[0], buffer.size(), bytes, len, &status);
+    ucnv_setToUCallBack(conv, UCNV_TO_U_CALLBACK_SUBSTITUTE, NULL, NULL, NULL, &status);
+    return U_SUCCESS(status);
+}
+
+// Candidate encoding detection of each native table: ICU per candidate
+// against one scanNativeEncodings() pass. Then whole files of the table
+// under its locale through MediaScannerClient and through TagConverter.
+static void benchDetection(int iterations)
+{
+    static const NativeEncoding candidates[] = {
+        kNativeEncodingShiftJIS, kNativeEncodingGBK, kNativeEncodingBig5, kNativeEncodingEUCKR
+    };
+    static const char* tableLocales[] = { NULL, NULL, "ko", "ja", "zh_CN", "zh" };
+    std::vector<UChar> buffer;
+    uint32_t sink = 0;
+
+    for (unsigned int t = 1; t < sizeof(bench_tables)/sizeof(bench_tables[0]); t++) {
+        const bench_table& table = bench_tables[t];
+        nsecs_t elapsed[2];
+
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int iter = 0; iter < iterations; iter++) {
+            for (unsigned int i = 0; i < table.size; i++) {
+                const char* s = table.table[i].native;
+                size_t len = strlen(s);
+                for (unsigned int c = 0; c < sizeof(candidates)/sizeof(candidates[0]); c++) {
+                    if (isWellFormedIn(nativeEncodingCharset(candidates[c]), s, len, buffer))
+                        sink |= candidates[c];
+                }
+            }
+        }
+        elapsed[0] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int iter = 0; iter < iterations; iter++) {
+            for (unsigned int i = 0; i < table.size; i++) {
+                const char* s = table.table[i].native;
+                sink |= scanNativeEncodings(s, strlen(s)).possible;
+            }
+        }
+        elapsed[1] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+        double values = (double)table.size * iterations;
+        printf("detection          %-18s icu %8.0f ns/tag  table %8.0f ns/tag\n",
+               table.name, elapsed[0] / values, elapsed[1] / values);
+
+        const char* locale = tableLocales[t] ? tableLocales[t] : "ko";
+        for (int converter = 0; converter < 2; converter++) {
+            TestableMediaScannerClient* client = new TestableMediaScannerClient();
+            client->setLocale(locale);
+            client->setTagConverterEnabled(converter);
+            client->initResults();
+            elapsed[converter] = timeFiles(client, table, iterations);
+            client->releaseResults();
+            delete client;
+        }
+        printf("file               %-18s %-6s libmedia %8.2f us/file  TagConverter %8.2f us/file\n",
+               table.name, locale,
+               nsToUs(elapsed[0] / iterations), nsToUs(elapsed[1] / iterations));
+    }
+
+    if (sink == 0xFFFFFFFF)
+        printf("\n");
+}
+
+// Albums of tracks that share their artist, album and album artist tags,
+// with a title of their own, scanned with and without a DetectionCache.
+static void benchAlbumCache(int iterations)
+{
+    static const unsigned int tableIdx[] = { 2, 3, 4, 5 };
+    static const char* tableLocales[] = { "ko", "ja", "zh_CN", "zh" };
+    const int albums = 20;
+    const int tracks = 12;
+    char title[512];
+
+    for (unsigned int n = 0; n < sizeof(tableIdx)/sizeof(tableIdx[0]); n++) {
+        const bench_table& t = bench_tables[tableIdx[n]];
+        int rounds = iterations / (albums * tracks) + 1;
+        nsecs_t elapsed[2];
+        DetectionCache cache(256);
+
+        for (int cached = 0; cached < 2; cached++) {
+            TestableMediaScannerClient* client = new TestableMediaScannerClient();
+            client->setLocale(tableLocales[n]);
+            client->setTagConverterEnabled(true);
+            if (cached)
+                client->setDetectionCache(&cache);
+            client->initResults();
+
+            nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+            for (int r = 0; r < rounds; r++) {
+                for (int a = 0; a < albums; a++) {
+                    for (int k = 0; k < tracks; k++) {
+                        snprintf(title, sizeof(title), "%s %d",
+                                 t.table[(a * tracks + k) % t.size].native, k + 1);
+                        client->beginFile();
+                        client->addNativeStringTagWithIdx(0, title);
+                        client->addNativeStringTagWithIdx(1, t.table[a % t.size].native);
+                        client->addNativeStringTagWithIdx(2, t.table[(a + 1) % t.size].native);
+                        client->addNativeStringTagWithIdx(3, t.table[(a + 2) % t.size].native);
+                        client->endFile();
+                    }
+                }
+            }
+            elapsed[cached] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+            client->releaseResults();
+            delete client;
+        }
+
+        const DetectionCache::Stats& stats = cache.stats();
+        double files = (double)rounds * albums * tracks;
+        printf("album cache        %-18s %-6s uncached %6.2f us/file  cached %6.2f us/file  "
+               "hit rate %3.0f%%  conversion hit rate %3.0f%%\n",
+               t.name, tableLocales[n],
+               nsToUs(elapsed[0] / files), nsToUs(elapsed[1] / files),
+               100.0 * stats.hits / (stats.hits + stats.misses),
+               100.0 * stats.conversionHits / (stats.conversionHits + stats.conversionMisses));
+    }
+}
+
+// Albums of tracks of one title each, decided per file and with an
+// AlbumEncodingVote per album. Once an album has decided, its files are
+// only checked against the locale encoding: the work saved is the share
+// of files that came after the decision.
+static void benchAlbumVote(int iterations)
+{
+    static const unsigned int tableIdx[] = { 1, 2, 3, 4, 5 };
+    static const char* tableLocales[] = { "ko", "ko", "ja", "zh_CN", "zh" };
+    const int albums = 20;
+    const int tracks = 12;
+
+    for (unsigned int n = 0; n < sizeof(tableIdx)/sizeof(tableIdx[0]); n++) {
+        const bench_table& t = bench_tables[tableIdx[n]];
+        int rounds = iterations / (albums * tracks) + 1;
+        nsecs_t elapsed[2];
+        AlbumEncodingVote album;
+        uint32_t decidedFiles = 0;
+        uint32_t followedFiles = 0;
+
+        for (int voted = 0; voted < 2; voted++) {
+            TestableMediaScannerClient* client = new TestableMediaScannerClient();
+            client->setLocale(tableLocales[n]);
+            client->setTagConverterEnabled(true);
+            if (voted)
+                client->setAlbumEncodingVote(&album);
+            client->initResults();
+
+            nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+            for (int r = 0; r < rounds; r++) {
+                for (int a = 0; a < albums; a++) {
+                    album.clear();
+                    for (int k = 0; k < tracks; k++) {
+                        client->beginFile();
+                        client->addNativeStringTagWithIdx(0,
+                                t.table[(a * tracks + k) % t.size].native);
+                        client->endFile();
+                    }
+                    decidedFiles += album.stats().decidedFiles;
+                    followedFiles += album.stats().followedFiles;
+                }
+            }
+            elapsed[voted] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+            client->releaseResults();
+            delete client;
+        }
+
+        double files = (double)rounds * albums * tracks;
+        printf("album vote         %-18s %-6s alone %6.2f us/file  voted %6.2f us/file  "
+               "%3.0f%% after the decision  %3.0f%% followed it\n",
+               t.name, tableLocales[n],
+               nsToUs(elapsed[0] / files), nsToUs(elapsed[1] / files),
+               100.0 * decidedFiles / files, 100.0 * followedFiles / files);
+    }
+}
+
+// Cost per tag from 10 to 100k tags per file, including reading every
+// result back. Results are index addressed, so it should stay flat.
+static void benchTagCountScaling(int iterations)
+{
+    static const int tagCounts[] = { 10, 100, 1000, 10000, 100000 };
+    const bench_table& t = bench_tables[0];    // strs_utf_8
+
+    TestableMediaScannerClient* client = new TestableMediaScannerClient();
+    client->setLocale("ko");
+    client->initResults();
+
+    for (unsigned int c = 0; c < sizeof(tagCounts)/sizeof(tagCounts[0]); c++) {
+        int tagCount = tagCounts[c];
+        int files = iterations * 100 / tagCount + 1;
+        nsecs_t readTime = 0;
+
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int f = 0; f < files; f++) {
+            client->beginFile();
+            for (int i = 0; i < tagCount; i++)
+                client->addStringTagWithIdx(i, t.table[i % t.size].native);
+            client->endFile();
+
+            nsecs_t readStart = systemTime(SYSTEM_TIME_MONOTONIC);
+            for (int i = 0; i < tagCount; i++) {
+                if (client->getResult(i) == NULL) {
+                    fprintf(stderr, "missing result %d of %d\n", i, tagCount);
+                    break;
+                }
+            }
+            readTime += systemTime(SYSTEM_TIME_MONOTONIC) - readStart;
+        }
+        nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+        double tags = (double)tagCount * files;
+        printf("tag count scaling  %6d tags/file  %8.0f ns/tag  getResult %6.1f ns/tag\n",
+               tagCount, elapsed / tags, readTime / tags);
+    }
+
+    client->releaseResults();
+    delete client;
+}
+
+// Files of four tags from every native table, scanned by a ScanDriver on
+// 1 to N threads; N is the number of online cores, at least 2 so the
+// stealing is exercised on a single core too.
+static void benchScanScaling(int iterations)
+{
+    const int tagsPerFile = 4;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 2)
+        cores = 2;
+
+    // the native strings of every table back to back; a file is four
+    // consecutive ones of a table.
+    std::vector<const char*> values;
+    for (unsigned int n = 1; n < sizeof(bench_tables)/sizeof(bench_tables[0]); n++) {
+        const bench_table& t = bench_tables[n];
+        for (unsigned int i = 0; i < t.size; i++)
+            values.push_back(t.table[i].native);
+    }
+
+    std::vector<ScanDriver::File> files;
+    while ((int)files.size() < iterations * 10) {
+        size_t base = 0;
+        for (unsigned int n = 1; n < sizeof(bench_tables)/sizeof(bench_tables[0]); n++) {
+            const bench_table& t = bench_tables[n];
+            for (unsigned int i = 0; i + tagsPerFile <= t.size; i++) {
+                ScanDriver::File f;
+                f.values = &values[base + i];
+                f.valueCount = tagsPerFile;
+                f.isNative = t.is_native;
+                files.push_back(f);
+            }
+            base += t.size;
+        }
+    }
+
+    ScanDriver driver("ko");
+    double base = 0;
+    long threads = 1;
+    for (;;) {
+        ScanDriver::Result result;
+        if (driver.run(files, threads, &result) != OK) {
+            fprintf(stderr, "scan failed on %ld threads\n", threads);
+            return;
+        }
+        double filesPerSec = result.fileCount / (result.elapsed / 1e9);
+        if (threads == 1)
+            base = filesPerSec;
+        printf("scan scaling       %2ld threads  %9.0f files/s  %9.0f tags/s  x%4.2f  %6u steals\n",
+               threads, filesPerSec, result.tagCount / (result.elapsed / 1e9),
+               filesPerSec / base, (unsigned int)result.steals);
+        if (threads == cores)
+            break;
+        // end on all the cores when they aren't a power of two.
+        threads = threads * 2 > cores ? cores : threads * 2;
+    }
+}
+
+// locale that detects a corpus encoding, NULL for those that need none.
+static const char* corpusLocale(const char* encoding)
+{
+    static const char* locales[][2] = {
+        { "windows-1252", "ko" },
+        { "EUC-KR", "ko" },
+        { "SHIFT-JIS", "ja" },
+        { "GB2312", "zh_CN" },
+        { "Big5", "zh" },
+    };
+    for (unsigned int i = 0; i < sizeof(locales)/sizeof(locales[0]); i++) {
+        if (!strcasecmp(locales[i][0], encoding))
+            return locales[i][1];
+    }
+    return NULL;
+}
+
+// Every string of a testee.bin from make_testee.py, in files of 50 tags
+// like the testee.h tables, straight from the mapping.
+static std::string mp3Dir()
+{
+    const char* dir = getenv("TMPDIR");
+    return std::string(dir ? dir : "/data/local/tmp") + "/MediaScannerClient_benchmark_mp3";
+}
+
+// Writes count MP3 files to dir. File i has a title from strs_EUC_KR
+// as ID3v2 Latin-1 text, for the ko locale the scan runs under, an artist from strs_utf_8 as UTF-16 with
+// a BOM, an album as UTF-8, a year, some audio and an ID3v1 tag.
+static status_t writeMp3Files(const std::string& dir, int count, size_t audioSize,
+                              std::vector<std::string>* paths)
+{
+    mkdir(dir.c_str(), 0755);
+    std::vector<std::string> artists = utf16Values(bench_tables[0]);
+    const bench_table& albums = bench_tables[0];
+    SyntheticMp3 mp3;
+    char name[32];
+
+    for (int i = 0; i < count; i++) {
+        const bench_table& titles = bench_tables[2];   // strs_EUC_KR
+        const char* title = titles.table[i % titles.size].native;
+        const std::string& artist = artists[i % artists.size()];
+        const char* album = albums.table[i % albums.size].utf_8;
+
+        mp3.clear();
+        mp3.setId3v2Version(3 + i % 2);
+        mp3.addTextFrame("TIT2", kId3Latin1, title, strlen(title));
+        mp3.addTextFrame("TPE1", kId3Utf16, artist.data(), artist.size());
+        mp3.addTextFrame("TALB", kId3Utf8, album, strlen(album));
+        mp3.addTextFrame("TYER", kId3Latin1, "2010", 4);
+        mp3.setAudioSize(audioSize);
+        mp3.setId3v1("title", "artist", "album", "2010");
+
+        snprintf(name, sizeof(name), "/%05d.mp3", i);
+        paths->push_back(dir + name);
+        status_t result = mp3.write(paths->back().c_str());
+        if (result != OK)
+            return result;
+    }
+    return OK;
+}
+
+// Drops the pages of the files from the page cache, which needs them
+// written back first. Returns false if the kernel wouldn't.
+static bool evictFiles(const std::vector<std::string>& paths)
+{
+    bool evicted = true;
+    for (size_t i = 0; i < paths.size(); i++) {
+        int fd = open(paths[i].c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        if (fdatasync(fd) != 0 || posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0)
+            evicted = false;
+        close(fd);
+    }
+    return evicted;
+}
+
+// The whole scan of a file: stat() it as MediaScanner does and hand it to
+// scanFile(), which mmap()s it and parses its tags.
+static nsecs_t scanMp3Files(TestableMediaScannerClient* client,
+                            const std::vector<std::string>& paths, size_t* bytes)
+{
+    *bytes = 0;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (size_t i = 0; i < paths.size(); i++) {
+        struct stat st;
+        if (stat(paths[i].c_str(), &st) != 0)
+            continue;
+        client->scanFile(paths[i].c_str(), st.st_mtime, st.st_size, false, false);
+        *bytes += st.st_size;
+    }
+    return systemTime(SYSTEM_TIME_MONOTONIC) - start;
+}
+
+// Takes the results of a ScanPipeline as the client's handleStringTag()
+// would, with a copy of each value.
+class TagSink : public MediaScannerClient {
+public:
+    virtual status_t scanFile(const char* path, long long lastModified,
+                              long long fileSize, bool isDirectory, bool noMedia) {
+        return OK;
+    }
+
+    virtual status_t handleStringTag(const char* name, const char* value) {
+        _value.assign(value);
+        return OK;
+    }
+
+    virtual status_t setMimeType(const char* mimeType) {
+        return OK;
+    }
+
+private:
+    std::string _value;
+};
+
+static void enableTagConverter(TestableMediaScannerClient* client)
+{
+    client->setTagConverterEnabled(true);
+}
+
+// The same through a ScanPipeline: the tags are read here while workers
+// convert the files before. Starting and finishing the pipeline count.
+static nsecs_t scanMp3FilesPipelined(ScanPipeline* pipeline, int workers,
+                                     const std::vector<std::string>& paths, size_t* bytes)
+{
+    *bytes = 0;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (pipeline->start(workers, 8) != OK)
+        return 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+        struct stat st;
+        if (stat(paths[i].c_str(), &st) != 0)
+            continue;
+        pipeline->scanFile(paths[i].c_str());
+        *bytes += st.st_size;
+    }
+    pipeline->finish();
+    return systemTime(SYSTEM_TIME_MONOTONIC) - start;
+}
+
+// End to end scan of synthetic MP3 files from a cold and a warm page
+// cache, through MediaScannerClient and through the TagConverter, on the
+// calling thread and pipelined with one or two conversion workers.
+static void benchMp3Scan(int iterations)
+{
+    const int count = iterations < 2000 ? iterations : 2000;
+    const size_t audioSize = 64 * 1024;
+    std::string dir = mp3Dir();
+    std::vector<std::string> paths;
+    if (writeMp3Files(dir, count, audioSize, &paths) != OK) {
+        printf("mp3 scan           can't write files to %s\n", dir.c_str());
+        return;
+    }
+
+    for (int converter = 0; converter < 2; converter++) {
+        TestableMediaScannerClient* client = new TestableMediaScannerClient();
+        client->setLocale("ko");
+        client->setTagConverterEnabled(converter);
+        client->initResults();
+
+        for (int warm = 0; warm < 2; warm++) {
+            bool isCold = !warm && evictFiles(paths);
+            size_t bytes;
+            nsecs_t elapsed = scanMp3Files(client, paths, &bytes);
+            double seconds = elapsed / 1e9;
+            printf("mp3 scan           %-9s %-14s %5d files %10.0f files/s %10.1f MB/s\n",
+                   converter ? "converter" : "client",
+                   warm ? "warm" : isCold ? "cold" : "cold (failed)", count,
+                   seconds > 0 ? count / seconds : 0,
+                   seconds > 0 ? bytes / seconds / (1024 * 1024) : 0);
+        }
+
+        client->releaseResults();
+        delete client;
+    }
+
+    for (int workers = 1; workers <= 2; workers++) {
+        TagSink sink;
+        ScanPipeline pipeline(&sink, "ko", enableTagConverter);
+        for (int warm = 0; warm < 2; warm++) {
+            bool isCold = !warm && evictFiles(paths);
+            size_t bytes;
+            nsecs_t elapsed = scanMp3FilesPipelined(&pipeline, workers, paths, &bytes);
+            double seconds = elapsed / 1e9;
+            printf("mp3 scan           pipeline  %-14s %5d files %10.0f files/s %10.1f MB/s"
+                   "  %d worker%s\n",
+                   warm ? "warm" : isCold ? "cold" : "cold (failed)", count,
+                   seconds > 0 ? count / seconds : 0,
+                   seconds > 0 ? bytes / seconds / (1024 * 1024) : 0,
+                   workers, workers > 1 ? "s" : "");
+        }
+    }
+
+    for (size_t i = 0; i < paths.size(); i++)
+        unlink(paths[i].c_str());
+    rmdir(dir.c_str());
+}
+
+static void benchCorpus(const char* path)
+{
+    const uint32_t tagsPerFile = 50;
+    TesteeCorpus corpus;
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (corpus.open(path) != OK)
+        return;
+    nsecs_t openTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    printf("corpus             %s  %u bytes  opened in %.2f us\n",
+           path, (unsigned int)corpus.size(), nsToUs(openTime));
+
+    for (int enc = 0; enc < corpus.encodingCount(); enc++) {
+        const char* locale = corpusLocale(corpus.encodingName(enc));
+        bool isNative = strcasecmp(corpus.encodingName(enc), "utf-8") != 0;
+        uint32_t items = corpus.itemCount(enc);
+        double bytes = 0;
+        unsigned int mismatches = 0;
+
+        TestableMediaScannerClient* client = new TestableMediaScannerClient();
+        if (locale)
+            client->setLocale(locale);
+        client->initResults();
+
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (uint32_t first = 0; first < items; first += tagsPerFile) {
+            uint32_t count = items - first < tagsPerFile ? items - first : tagsPerFile;
+            client->beginFile();
+            for (uint32_t i = 0; i < count; i++) {
+                size_t len;
+                const char* native = corpus.native(enc, first + i, &len);
+                bytes += len;
+                if (isNative)
+                    client->addNativeStringTagWithIdx(i, native);
+                else
+                    client->addStringTagWithIdx(i, native);
+            }
+            client->endFile();
+
+            for (uint32_t i = 0; i < count; i++) {
+                const char* result = client->getResult(i);
+                if (result == NULL || strcmp(result, corpus.utf8(enc, first + i)))
+                    mismatches++;
+            }
+        }
+        nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+        client->releaseResults();
+        delete client;
+
+        printf("corpus             %-18s %-6s %8u tags %10.0f tags/s %8.2f MB/s  %u mismatches\n",
+               corpus.encodingName(enc), locale ? locale : "-", items,
+               items / (elapsed / 1e9), bytes / (elapsed / 1e9) / (1024 * 1024), mismatches);
+    }
+}
+
+}
+
+using namespace android;
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [iterations [testee.bin]]\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 1000;
+    if (argc > 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (argc >= 2) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    printf("# %d files per case, one tag per table entry\n", iterations);
+    for (unsigned int l = 0; l < sizeof(bench_locales)/sizeof(bench_locales[0]); l++) {
+        for (unsigned int t = 0; t < sizeof(bench_tables)/sizeof(bench_tables[0]); t++)
+            benchTable(bench_tables[t], bench_locales[l], iterations);
+    }
+
+    benchConverterReuse(iterations);
+    benchLatin1(iterations);
+    benchUtf16(iterations);
+    benchTagCountScaling(iterations);
+    benchPrescreen(iterations);
+    benchDetection(iterations);
+    benchAlbumCache(iterations);
+    benchAlbumVote(iterations);
+    benchTagView(iterations);
+    benchBatch(iterations);
+    benchLazy(iterations);
+    benchScanScaling(iterations);
+    benchMp3Scan(iterations);
+    if (argc == 3)
+        benchCorpus(argv[2]);
+    ConverterCache::releaseThreadCache();
+
+    return 0;
+}
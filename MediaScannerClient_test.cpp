@@ -17,116 +17,29 @@
 #define LOG_TAG "MediaScannerClient_test"
 #include <utils/Log.h>
 
-#include <utils/StringArray.h>
-#include <unicode/ustring.h>
-#include <unicode/ucnv.h>
-#include <media/mediascanner.h>
-
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "AlbumEncodingVote.h"
+#include "AllocationCounter.h"
+#include "BenchmarkStats.h"
+#include "Latin1Utf8.h"
+#include "NativeEncodingDetector.h"
+#include "ScanDriver.h"
+#include "ScanPipeline.h"
+#include "ScanStats.h"
+#include "SpscQueue.h"
+#include "SyntheticMp3.h"
+#include "TagNameTable.h"
+#include "TagResults.h"
+#include "TesteeCorpus.h"
+#include "TestableMediaScannerClient.h"
 #include "testee.h"
 
 namespace android {
 
-class TestableMediaScannerClient : public MediaScannerClient {
-private:
-    StringArray* _results;
-    bool _isResultSorted;
-
-public:
-    // not use these members.
-    virtual status_t scanFile(const char* path, long long lastModified,
-                              long long fileSize, bool isDirectory, bool noMedia)  {
-        return OK;
-    }
-    virtual status_t setMimeType(const char* mimeType) {
-        return OK;
-    }
-
-    // push a tag's name/value pair to client. It called from addStringTag() and endFile()
-    // for this TestableMediaScannerClient, It push name+value to _results.
-    virtual status_t handleStringTag(const char* name, const char* value) {
-        if (_results == NULL)
-            return UNKNOWN_ERROR;
-
-        int conLen = strlen(name) + strlen(value) + 1;
-        char* conBuff = new char[conLen];
-        if (!conBuff)
-            return UNKNOWN_ERROR;
-
-        sprintf(conBuff, "%s%s", name, value);
-        _results->push_back(conBuff);
-
-        delete[] conBuff;
-
-        return OK;
-    }
-
-    // instead of using string tag name, we use sorting idx for
-    // sort final result.
-    bool addStringTagWithIdx(int sortingIdx, const char* value) {
-        char strSortingIdx[4 + 1];
-        sprintf(strSortingIdx, "%04d", sortingIdx);
-        return addStringTag((const char*)strSortingIdx, value);
-    }
-
-    // ID3.cpp have been convert all native encoding strings to ISO8859-1
-    // To simulate this situaltion turn forceConvertToLatin1 to true.
-    bool addNativeStringTagWithIdx(int sortingIdx, const char* value,
-                                   bool forceConvertToLatin1 = true) {
-        char* buffer = NULL;
-        if (forceConvertToLatin1) {
-            UErrorCode status = U_ZERO_ERROR;
-
-            UConverter* conv = ucnv_open("iso_8859_1", &status);
-            if (U_FAILURE(status)) {
-                LOGE("could not create UConverter for iso_8859_1\n");
-                return false;
-            }
-            UConverter* utf8Conv = ucnv_open("UTF-8", &status);
-            if (U_FAILURE(status)) {
-                LOGE("could not create UConverter for UTF-8\n");
-                ucnv_close(conv);
-                return false;
-            }
-
-            const char* src = value;
-            int len = strlen(src);
-            int targetLen = len * 3 + 1;
-            buffer = new char[targetLen];
-            char* target = buffer;
-            ucnv_convertEx(utf8Conv, conv, &target, target + targetLen,
-                           &src, src + len, NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
-            if (U_FAILURE(status)) {
-                LOGE("ucnv_convertEx failed: %d\n", status);
-                return false;
-            }
-            // zero terminate
-            *target = 0;
-        } else {
-            buffer = (char*)value;
-        }
-
-        return addStringTagWithIdx(sortingIdx, buffer);
-    }
-
-    void initResults() {
-        _results = new StringArray;
-        _isResultSorted = false;
-    }
-
-    void releaseResults() {
-        delete _results;
-    }
-
-    const char* getResult(int idx) {
-        if (!_isResultSorted) {
-            _results->sort(StringArray::cmpAscendingAlpha);
-            _isResultSorted = true;
-        }
-        return _results->getEntry(idx) + 4;
-    }
-};
-
 class MediaScannerClientTest : public testing::Test {
 protected:
     TestableMediaScannerClient* client;
@@ -157,6 +70,28 @@ TEST_F(MediaScannerClientTest, IsResultSorted)
     EXPECT_STREQ(client->getResult(2), "third");
 }
 
+// results are read back by idx whatever the count of tags is.
+TEST_F(MediaScannerClientTest, IsResultIndexedBeyond9999)
+{
+    const int tagCount = 12345;
+    char value[16];
+
+    client->beginFile();
+    for (int i = tagCount - 1; i >= 0; i--) {
+        snprintf(value, sizeof(value), "v%d", i);
+        client->addStringTagWithIdx(i, value);
+    }
+    client->endFile();
+
+    ASSERT_EQ(client->getResultCount(), tagCount);
+    for (int i = 0; i < tagCount; i++) {
+        snprintf(value, sizeof(value), "v%d", i);
+        EXPECT_STREQ(client->getResult(i), value);
+    }
+    EXPECT_TRUE(client->getResult(tagCount) == NULL);
+}
+
+// Tags are given one by one, then all at once with addStringTagsWithIdx().
 static void __test_str_pairs(TestableMediaScannerClient* client,
                              str_pair* table, unsigned int table_size, bool is_native)
 {
@@ -172,100 +107,643 @@ static void __test_str_pairs(TestableMediaScannerClient* client,
     for (unsigned int i = 0; i < table_size; i++) {
         EXPECT_STREQ(client->getResult(i), table[i].utf_8);
     }
+
+    std::vector<const char*> values;
+    for (unsigned int i = 0; i < table_size; i++)
+        values.push_back(table[i].native);
+
+    client->beginFile();
+    EXPECT_TRUE(client->addStringTagsWithIdx(&values[0], table_size, is_native));
+    client->endFile();
+
+    for (unsigned int i = 0; i < table_size; i++) {
+        EXPECT_STREQ(client->getResult(i), table[i].utf_8) << "batched";
+    }
 }
 
-// utf-8 should not be demaged by -whatever- current locale.
+// Every table under every locale is in EncodingMatrixTest, below.
 #define test_utf8_str_pairs(c, t) __test_str_pairs(c, t, (sizeof(t)/sizeof(str_pair)), false)
-TEST_F(MediaScannerClientTest, UTF8)
+#define test_native_str_pairs(c, t) __test_str_pairs(c, t, (sizeof(t)/sizeof(str_pair)), true)
+
+TEST(TagPrescreenTest, classify)
 {
-    test_utf8_str_pairs(client, strs_utf_8);
+    EXPECT_EQ(classifyTagValue("", 0), kTagAscii);
+    const char* ascii = "plain ascii, longer than 32 bytes..";
+    EXPECT_EQ(classifyTagValue(ascii, strlen(ascii)), kTagAscii);
+    // U+0E41, can't be widened Latin-1, past the first 32 byte block
+    const char* thai = "ascii past the first 32 byte block: \xE0\xB9\x81.";
+    EXPECT_EQ(asciiPrefixLength(thai, strlen(thai)), 36u);
+    EXPECT_EQ(classifyTagValue(thai, strlen(thai)), kTagUtf8);
+    // "é" may be a widened native byte
+    EXPECT_EQ(classifyTagValue("caf\xC3\xA9", 5), kTagNeedsDetection);
+    // truncated and overlong sequences
+    EXPECT_EQ(classifyTagValue("\xE0\xB9", 2), kTagNeedsDetection);
+    EXPECT_EQ(classifyTagValue("\xC0\xAF", 2), kTagNeedsDetection);
+    EXPECT_EQ(classifyTagValue("\xE0\xB9\x81\xB9", 4), kTagNeedsDetection);
+
+    for (size_t len = 0; len < 70; len++) {
+        char buf[70];
+        memset(buf, 'a', sizeof(buf));
+        if (len > 0)
+            buf[len - 1] = (char)0x80;
+        EXPECT_EQ(asciiPrefixLength(buf, len), len > 0 ? len - 1 : 0);
+    }
 }
 
-TEST_F(MediaScannerClientTest, UTF8_with_ko)
+typedef void (*client_setup)(TestableMediaScannerClient* client);
+
+static void enable_prescreen(TestableMediaScannerClient* client)
 {
-    client->setLocale("ko");
-    test_utf8_str_pairs(client, strs_utf_8);
+    client->setPrescreenEnabled(true);
 }
 
-TEST_F(MediaScannerClientTest, UTF8_with_ja)
+static void enable_tag_converter(TestableMediaScannerClient* client)
 {
-    client->setLocale("ja");
-    test_utf8_str_pairs(client, strs_utf_8);
+    client->setTagConverterEnabled(true);
 }
 
-TEST_F(MediaScannerClientTest, UTF8_with_zh)
+static void enable_tag_view(TestableMediaScannerClient* client)
 {
-    client->setLocale("zh");
-    test_utf8_str_pairs(client, strs_utf_8);
+    client->setTagConverterEnabled(true);
+    client->setTagViewEnabled(true);
 }
 
-TEST_F(MediaScannerClientTest, UTF8_with_zh_CN)
+// A client set up by setup must end a file with the same results as
+// MediaScannerClient does.
+static void __test_same_results(client_setup setup, str_pair* table, unsigned int table_size,
+                                bool is_native, const char* locale)
 {
-    client->setLocale("zh_CN");
-    test_utf8_str_pairs(client, strs_utf_8);
+    TestableMediaScannerClient clients[2];
+
+    for (int i = 0; i < 2; i++) {
+        if (i == 1)
+            setup(&clients[i]);
+        if (locale)
+            clients[i].setLocale(locale);
+
+        clients[i].beginFile();
+        for (unsigned int j = 0; j < table_size; j++) {
+            if (is_native)
+                clients[i].addNativeStringTagWithIdx(j, table[j].native);
+            else
+                clients[i].addStringTagWithIdx(j, table[j].native);
+        }
+        clients[i].endFile();
+    }
+
+    ASSERT_EQ(clients[0].getResultCount(), clients[1].getResultCount());
+    for (unsigned int j = 0; j < table_size; j++)
+        EXPECT_STREQ(clients[0].getResult(j), clients[1].getResult(j)) << "locale " << (locale ? locale : "-");
 }
 
-// Latin-1 should not be demaged by -whatever- current locale
-#define test_native_str_pairs(c, t) __test_str_pairs(c, t, (sizeof(t)/sizeof(str_pair)), true)
-TEST_F(MediaScannerClientTest, Latin_1)
+// for every table under every locale
+static void test_same_results(client_setup setup)
 {
-    test_native_str_pairs(client, strs_windows_1252);
+    static const char* locales[] = { NULL, "ko", "ja", "zh", "zh_CN" };
+
+#define __test_same_results_for(t, n) \
+    __test_same_results(setup, t, (sizeof(t)/sizeof(str_pair)), n, locales[l])
+
+    for (unsigned int l = 0; l < sizeof(locales)/sizeof(locales[0]); l++) {
+        __test_same_results_for(strs_utf_8, false);
+        __test_same_results_for(strs_windows_1252, true);
+        __test_same_results_for(strs_EUC_KR, true);
+        __test_same_results_for(strs_SHIFT_JIS, true);
+        __test_same_results_for(strs_GB2312, true);
+        __test_same_results_for(strs_Big5, true);
+    }
+
+#undef __test_same_results_for
 }
 
-TEST_F(MediaScannerClientTest, Latin_1_with_ko)
+// Native values of table with the UTF-8 ones of strs_utf_8 in between,
+// which a prescreen takes out of the values endFile() detects over.
+static void __test_same_results_mixed(client_setup setup, str_pair* table,
+                                      unsigned int table_size, const char* locale)
 {
-    client->setLocale("ko");
-    test_native_str_pairs(client, strs_windows_1252);
+    const unsigned int utf8_size = sizeof(strs_utf_8)/sizeof(str_pair);
+    TestableMediaScannerClient clients[2];
+
+    setup(&clients[1]);
+    for (int i = 0; i < 2; i++) {
+        if (locale)
+            clients[i].setLocale(locale);
+
+        clients[i].beginFile();
+        for (unsigned int j = 0; j < table_size; j++) {
+            clients[i].addStringTagWithIdx(2 * j, strs_utf_8[j % utf8_size].native);
+            clients[i].addNativeStringTagWithIdx(2 * j + 1, table[j].native);
+        }
+        clients[i].endFile();
+    }
+
+    ASSERT_EQ(clients[0].getResultCount(), clients[1].getResultCount());
+    for (unsigned int j = 0; j < 2 * table_size; j++)
+        EXPECT_STREQ(clients[0].getResult(j), clients[1].getResult(j)) << "locale " << (locale ? locale : "-");
 }
 
-TEST_F(MediaScannerClientTest, Latin_1_with_ja)
+static void test_same_results_mixed(client_setup setup)
 {
-    client->setLocale("ja");
-    test_native_str_pairs(client, strs_windows_1252);
+    static const char* locales[] = { NULL, "ko", "ja", "zh", "zh_CN" };
+
+#define __test_same_results_mixed_for(t) \
+    __test_same_results_mixed(setup, t, (sizeof(t)/sizeof(str_pair)), locales[l])
+
+    for (unsigned int l = 0; l < sizeof(locales)/sizeof(locales[0]); l++) {
+        __test_same_results_mixed_for(strs_windows_1252);
+        __test_same_results_mixed_for(strs_EUC_KR);
+        __test_same_results_mixed_for(strs_SHIFT_JIS);
+        __test_same_results_mixed_for(strs_GB2312);
+        __test_same_results_mixed_for(strs_Big5);
+    }
+
+#undef __test_same_results_mixed_for
 }
 
-TEST_F(MediaScannerClientTest, Latin_1_with_zh)
+// The locale whose encoding is encoding, NULL for one no locale detects.
+static const char* native_locale(const char* encoding)
 {
-    client->setLocale("zh");
-    test_native_str_pairs(client, strs_windows_1252);
+    static const char* const locales[][2] = {
+        { "ko", "EUC-KR" }, { "ja", "SHIFT-JIS" }, { "zh", "Big5" }, { "zh_CN", "GB2312" },
+    };
+    for (unsigned int l = 0; l < sizeof(locales)/sizeof(locales[0]); l++) {
+        if (!strcasecmp(encoding, locales[l][1]))
+            return locales[l][0];
+    }
+    return NULL;
 }
 
-TEST_F(MediaScannerClientTest, Latin_1_with_zh_CN)
+static bool is_utf8_encoding(const char* encoding)
 {
-    client->setLocale("zh_CN");
-    test_native_str_pairs(client, strs_windows_1252);
+    return !strcasecmp(encoding, "utf-8") || !strcasecmp(encoding, "ascii");
 }
 
-// euc-kr should be changed to utf-8 when current locale is "ko"
-TEST_F(MediaScannerClientTest, EUC_KR_with_ko)
+static bool is_latin1_encoding(const char* encoding)
 {
-    client->setLocale("ko");
-    test_native_str_pairs(client, strs_EUC_KR);
+    return !strcasecmp(encoding, "windows-1252") || !strcasecmp(encoding, "ISO-8859-1");
+}
+
+// What a client under a locale makes of the tables of an encoding.
+enum expectation {
+    // the utf-8 of the table: utf-8 and Latin-1 under any locale, and a
+    // native encoding under its own locale.
+    kExpectUtf8,
+    // the bytes as Latin-1, left alone without a locale that detects.
+    kExpectLatin1,
+    // another locale may take the bytes for its own encoding, or not,
+    // string by string; the TagConverter only has to agree with
+    // MediaScannerClient.
+    kExpectSameAsMediaScannerClient,
+};
+
+static expectation expected_for(const char* encoding, const char* locale)
+{
+    if (is_utf8_encoding(encoding) || is_latin1_encoding(encoding))
+        return kExpectUtf8;
+    if (!locale)
+        return kExpectLatin1;
+    const char* own = native_locale(encoding);
+    if (own && !strcmp(own, locale))
+        return kExpectUtf8;
+    return kExpectSameAsMediaScannerClient;
 }
 
-// SHIFT-JIS should be changed to utf-8 when current locale is "ja"
-TEST_F(MediaScannerClientTest, SHIFT_JIS_with_ja)
+// One encoding x locale combination of the testee.h registry.
+struct matrix_param {
+    const enc_table* table;
+    const char* locale;         // NULL for the default
+    expectation expected;
+};
+
+// names the combination in gtest's output, e.g. "EUC-KR under ja".
+void PrintTo(const matrix_param& p, std::ostream* os)
 {
-    client->setLocale("ja");
-    test_native_str_pairs(client, strs_SHIFT_JIS);
+    static const char* const names[] = { "utf-8", "latin-1", "as MediaScannerClient" };
+    *os << p.table->encoding << " under " << (p.locale ? p.locale : "-")
+        << ", expecting " << names[p.expected];
 }
 
-// GBK should be changed to utf-8 when current locale is "zh_CN"
-TEST_F(MediaScannerClientTest, GBK_with_with_zh_CN)
+static std::vector<matrix_param> matrix_params()
 {
-    client->setLocale("zh_CN");
-    test_native_str_pairs(client, strs_GB2312);
+    static const char* locales[] = { NULL, "ko", "ja", "zh", "zh_CN" };
+    std::vector<matrix_param> params;
+    for (unsigned int e = 0; e < enc_table_count; e++) {
+        for (unsigned int l = 0; l < sizeof(locales)/sizeof(locales[0]); l++) {
+            matrix_param p;
+            p.table = &enc_tables[e];
+            p.locale = locales[l];
+            p.expected = expected_for(p.table->encoding, p.locale);
+            params.push_back(p);
+        }
+    }
+    return params;
 }
 
-// BIG should be changed to utf-8 when current locale is "zh"
-TEST_F(MediaScannerClientTest, BIG5_with_zh)
+class EncodingMatrixTest : public testing::TestWithParam<matrix_param> {
+};
+
+// A file of the table's strings, tag by tag and then as one batch,
+// through MediaScannerClient and the TagConverter.
+TEST_P(EncodingMatrixTest, converts_table)
 {
-    client->setLocale("zh");
-    test_native_str_pairs(client, strs_Big5);
+    const matrix_param& p = GetParam();
+    const enc_table& t = *p.table;
+    bool is_native = !is_utf8_encoding(t.encoding);
+
+    if (p.expected == kExpectSameAsMediaScannerClient) {
+        __test_same_results(enable_tag_converter, t.table, t.size, is_native, p.locale);
+        return;
+    }
+
+    std::vector<char> buffer;
+    std::vector<const char*> values;
+    for (unsigned int i = 0; i < t.size; i++)
+        values.push_back(t.table[i].native);
+
+    for (int converter = 0; converter < 2; converter++) {
+        TestableMediaScannerClient client;
+        client.setTagConverterEnabled(converter);
+        if (p.locale)
+            client.setLocale(p.locale);
+
+        for (int batched = 0; batched < 2; batched++) {
+            client.beginFile();
+            if (batched) {
+                EXPECT_TRUE(client.addStringTagsWithIdx(&values[0], t.size, is_native));
+            } else {
+                for (unsigned int i = 0; i < t.size; i++) {
+                    if (is_native)
+                        client.addNativeStringTagWithIdx(i, t.table[i].native);
+                    else
+                        client.addStringTagWithIdx(i, t.table[i].native);
+                }
+            }
+            client.endFile();
+
+            for (unsigned int i = 0; i < t.size; i++) {
+                const char* expected = t.table[i].utf_8;
+                if (p.expected == kExpectLatin1) {
+                    buffer.resize(strlen(t.table[i].native) * 2 + 1);
+                    TestableMediaScannerClient::toLatin1Utf8(t.table[i].native, &buffer[0]);
+                    expected = &buffer[0];
+                }
+                EXPECT_STREQ(expected, client.getResult(i))
+                    << (converter ? "TagConverter " : "MediaScannerClient ")
+                    << (batched ? "batched " : "") << "item " << i;
+            }
+        }
+    }
+}
+
+// old gtest only knows the test case name
+#ifndef INSTANTIATE_TEST_SUITE_P
+#define INSTANTIATE_TEST_SUITE_P INSTANTIATE_TEST_CASE_P
+#endif
+
+INSTANTIATE_TEST_SUITE_P(testee, EncodingMatrixTest, testing::ValuesIn(matrix_params()));
+
+TEST(TagPrescreenTest, same_results_as_MediaScannerClient)
+{
+    test_same_results(enable_prescreen);
+    test_same_results_mixed(enable_prescreen);
+}
+
+TEST(NativeEncodingDetectorTest, scan)
+{
+    NativeEncodingScan scan;
+
+    // EUC-KR, whole and with the trail byte of the last char chopped
+    scan = scanNativeEncodings("\xb9\xce\xc1\xd6\xc0\xda", 6);
+    EXPECT_TRUE(scan.possible & kNativeEncodingEUCKR);
+    EXPECT_FALSE(scan.truncated & kNativeEncodingEUCKR);
+    scan = scanNativeEncodings("\xb9\xce\xc1\xd6\xc0", 5);
+    EXPECT_TRUE(scan.possible & kNativeEncodingEUCKR);
+    EXPECT_TRUE(scan.truncated & kNativeEncodingEUCKR);
+
+    // Shift-JIS trail byte in the ASCII range, half width katakana
+    scan = scanNativeEncodings("\x8b\x76\x89\x93\x82\xcc\xe3\x4a", 8);
+    EXPECT_TRUE(scan.possible & kNativeEncodingShiftJIS);
+    EXPECT_FALSE(scan.possible & kNativeEncodingEUCKR);
+    scan = scanNativeEncodings("\xb1\xb2", 2);
+    EXPECT_TRUE(scan.possible & kNativeEncodingShiftJIS);
+
+    // Latin-1 words are neither Shift-JIS nor Big5 nor GB2312.
+    scan = scanNativeEncodings("A J\xe1szber\xe9nyi", 13);
+    EXPECT_EQ(scan.possible & ~kNativeEncodingEUCKR, 0u);
+    scan = scanNativeEncodings("Dani\xeblle", 8);
+    EXPECT_EQ(scan.possible, 0u);
+
+    // plain ASCII fits anything
+    scan = scanNativeEncodings("ascii", 5);
+    EXPECT_EQ(scan.possible, (uint32_t)kNativeEncodingAll);
+}
+
+// GB2312 leaves rows 0xAA to 0xAF unassigned, and MediaScannerClient
+// takes no lead byte there for GBK. A short Big5 title with one must be
+// widened under zh_CN, not converted as GBK.
+TEST(NativeEncodingDetectorTest, gbk_skips_unassigned_rows)
+{
+    static const char big5[] = "\xA4\xA3\xA6\xD1\xAA\xBA\xB6\xC7\xBB\xA1";
+    NativeEncodingScan scan = scanNativeEncodings(big5, sizeof(big5) - 1);
+    EXPECT_TRUE(scan.possible & kNativeEncodingBig5);
+    EXPECT_FALSE(scan.possible & kNativeEncodingGBK);
+    for (int lead = 0xAA; lead <= 0xAF; lead++) {
+        char bytes[] = { (char)lead, (char)0xA1 };
+        EXPECT_FALSE(scanNativeEncodings(bytes, 2).possible & kNativeEncodingGBK) << lead;
+    }
+    EXPECT_TRUE(scanNativeEncodings("\xA9\xA1\xB0\xA1", 4).possible & kNativeEncodingGBK);
+
+    TestableMediaScannerClient clients[2];
+    clients[1].setTagConverterEnabled(true);
+    for (int i = 0; i < 2; i++) {
+        clients[i].setLocale("zh_CN");
+        clients[i].beginFile();
+        clients[i].addNativeStringTagWithIdx(0, big5);
+        clients[i].endFile();
+    }
+    std::vector<char> latin1(sizeof(big5) * 2);
+    TestableMediaScannerClient::toLatin1Utf8(big5, &latin1[0]);
+    EXPECT_STREQ(&latin1[0], clients[0].getResult(0));
+    EXPECT_STREQ(&latin1[0], clients[1].getResult(0));
+}
+
+TEST(TagConverterTest, same_results_as_MediaScannerClient)
+{
+    test_same_results(enable_tag_converter);
+}
+
+TEST(TagViewTest, same_results_as_MediaScannerClient)
+{
+    test_same_results(enable_tag_view);
+}
+
+// Views stay valid to the next beginFile(), through every tag added after
+// them, including from the reused buffer of addNativeStringTagWithIdx().
+TEST(TagViewTest, views_live_until_beginFile)
+{
+    TestableMediaScannerClient client;
+    enable_tag_view(&client);
+    client.setLocale("ko");
+
+    client.beginFile();
+    client.addStringTagWithIdx(0, "ascii");
+    client.addNativeStringTagWithIdx(1, strs_EUC_KR[0].native);
+    client.addStringTagWithIdx(2, "\xED\x95\x9C");
+    client.addNativeStringTagWithIdx(3, strs_EUC_KR[1].native);
+    client.endFile();
+
+    ASSERT_EQ(4, client.getResultCount());
+    EXPECT_STREQ("ascii", client.getResult(0));
+    EXPECT_STREQ(strs_EUC_KR[0].utf_8, client.getResult(1));
+    EXPECT_STREQ("\xED\x95\x9C", client.getResult(2));
+    EXPECT_STREQ(strs_EUC_KR[1].utf_8, client.getResult(3));
+}
+
+static void enable_lazy_conversion(TestableMediaScannerClient* client)
+{
+    enable_tag_view(client);
+    client->setLazyConversionEnabled(true);
+}
+
+TEST(LazyConversionTest, same_results_as_MediaScannerClient)
+{
+    test_same_results(enable_lazy_conversion);
+}
+
+// endFile() leaves the values that need detection to the first
+// getResult() of each, which then converts it once.
+TEST(LazyConversionTest, converts_on_first_access)
+{
+    const unsigned int size = sizeof(strs_EUC_KR)/sizeof(str_pair);
+    TestableMediaScannerClient client;
+    enable_lazy_conversion(&client);
+    client.setLocale("ko");
+
+    ConverterCache::releaseThreadCache();
+    client.beginFile();
+    client.addStringTagWithIdx(0, "ascii");
+    for (unsigned int i = 0; i < size; i++)
+        client.addNativeStringTagWithIdx(i + 1, strs_EUC_KR[i].native);
+    client.endFile();
+    EXPECT_EQ(0, ConverterCache::openCount());
+
+    ASSERT_EQ((int)size + 1, client.getResultCount());
+    EXPECT_STREQ("ascii", client.getResult(0));
+    EXPECT_EQ(0, ConverterCache::openCount());
+    const char* value = client.getResult(3);
+    EXPECT_STREQ(strs_EUC_KR[2].utf_8, value);
+    EXPECT_EQ(2, ConverterCache::openCount());
+    EXPECT_EQ(value, client.getResult(3));
+    for (unsigned int i = size; i > 0; i--)
+        EXPECT_STREQ(strs_EUC_KR[i - 1].utf_8, client.getResult(i));
+    EXPECT_TRUE(client.getResult(size + 1) == NULL);
+
+    // the next file drops the previous lazy values
+    test_native_str_pairs(&client, strs_windows_1252);
+    ConverterCache::releaseThreadCache();
+}
+
+TEST(TagNameTableTest, intern)
+{
+    TagNameTable names;
+    int32_t title = names.intern("title", 5);
+    int32_t artist = names.intern("artist", 6);
+
+    EXPECT_GE(title, (int32_t)TagNameTable::kFirstNamedTagId);
+    EXPECT_NE(title, artist);
+    EXPECT_EQ(title, names.intern("title", 5));
+    EXPECT_EQ(title, names.intern("titles", 5));
+    EXPECT_STREQ("artist", names.name(artist));
+    EXPECT_TRUE(names.name(0) == NULL);
+
+    // past the first growth of the table
+    char name[16];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "tag%d", i);
+        EXPECT_EQ(names.intern(name, strlen(name)), names.intern(name, strlen(name)));
+    }
+    EXPECT_EQ(1002u, names.size());
+    EXPECT_EQ(artist, names.intern("artist", 6));
+}
+
+TEST(TagResultsTest, ordered_by_id)
+{
+    TagResults results;
+
+    // in increasing order, no sorting
+    results.add(0, "a", 1);
+    results.add(2, "bc", 2);
+    ASSERT_EQ(2u, results.count());
+    EXPECT_EQ(2, results.id(1));
+
+    // out of order and an id again, which is kept after the first
+    results.add(1, "d", 1);
+    results.add(0, "ef", 2);
+    ASSERT_EQ(4u, results.count());
+    size_t len;
+    EXPECT_STREQ("a", results.value(0, &len));
+    EXPECT_EQ(1u, len);
+    EXPECT_STREQ("ef", results.value(1, &len));
+    EXPECT_EQ(2u, len);
+    EXPECT_EQ(0, results.id(1));
+    EXPECT_STREQ("d", results.value(2));
+    EXPECT_STREQ("bc", results.value(3, &len));
+    EXPECT_EQ(2u, len);
+    EXPECT_TRUE(results.value(4) == NULL);
+    EXPECT_EQ(-1, results.id(4));
+
+    // equal ids in increasing order need no sorting either
+    results.clear();
+    results.add(3, "x", 1);
+    results.add(3, "y", 1);
+    ASSERT_EQ(2u, results.count());
+    EXPECT_STREQ("x", results.value(0));
+    EXPECT_STREQ("y", results.value(1));
+
+    results.clear();
+    EXPECT_EQ(0u, results.count());
+    EXPECT_GT(results.capacity(), 0u);
+}
+
+TEST(TagResultsTest, deferred)
+{
+    TagResults results;
+    uint32_t token;
+
+    results.add(0, "a", 1);
+    results.addDeferred(1, 7);
+    results.add(2, "bc", 2);
+    results.addDeferred(0, 9);     // after "a"
+
+    ASSERT_EQ(4u, results.count());
+    size_t len;
+    EXPECT_FALSE(results.deferred(0, &token));
+    EXPECT_STREQ("a", results.value(0, &len));
+    EXPECT_EQ(1u, len);
+    EXPECT_TRUE(results.deferred(1, &token));
+    EXPECT_EQ(9u, token);
+    EXPECT_TRUE(results.value(1) == NULL);
+    EXPECT_TRUE(results.deferred(2, &token));
+    EXPECT_EQ(7u, token);
+    EXPECT_FALSE(results.deferred(3, &token));
+    EXPECT_STREQ("bc", results.value(3, &len));
+    EXPECT_EQ(2u, len);
+    EXPECT_FALSE(results.deferred(4, &token));
+
+    results.clear();
+    results.add(0, "a", 1);
+    EXPECT_FALSE(results.deferred(0, &token));
+    EXPECT_STREQ("a", results.value(0));
+}
+
+// names that aren't indices are interned and follow the indexed tags
+TEST_F(MediaScannerClientTest, named_tags)
+{
+    client->beginFile();
+    client->handleStringTag("title", "Title");
+    client->handleStringTag("1", "one");
+    client->handleStringTag("artist", "Artist");
+    client->handleStringTag("title", "Title 2");
+    client->endFile();
+
+    // a name handled twice keeps both values, in order.
+    ASSERT_EQ(4, client->getResultCount());
+    EXPECT_EQ(1, client->getResultId(0));
+    EXPECT_STREQ("one", client->getResult(0));
+    EXPECT_STREQ("title", client->getTagName(client->getResultId(1)));
+    EXPECT_STREQ("Title", client->getResult(1));
+    EXPECT_STREQ("title", client->getTagName(client->getResultId(2)));
+    EXPECT_STREQ("Title 2", client->getResult(2));
+    EXPECT_STREQ("artist", client->getTagName(client->getResultId(3)));
+    EXPECT_STREQ("Artist", client->getResult(3));
+    EXPECT_TRUE(client->getTagName(1) == NULL);
+}
+
+TEST(DetectionCacheTest, lru)
+{
+    DetectionCache cache(2);
+    NativeEncodingScan scan = scanNativeEncodings("\xb0\xed", 2);
+    NativeEncodingScan found;
+
+    cache.storeScan(kNativeEncodingEUCKR, "\xb0\xed", 2, scan);
+    cache.storeScan(kNativeEncodingEUCKR, "\xb9\xe9", 2, scan);
+    EXPECT_FALSE(cache.lookupScan(kNativeEncodingGBK, "\xb0\xed", 2, &found));
+    EXPECT_TRUE(cache.lookupScan(kNativeEncodingEUCKR, "\xb0\xed", 2, &found));
+    EXPECT_EQ(found.possible, scan.possible);
+
+    // "\xb9\xe9" is the least recently used now.
+    cache.storeScan(kNativeEncodingEUCKR, "\xc0\xda", 2, scan);
+    EXPECT_EQ(cache.stats().evictions, 1u);
+    EXPECT_FALSE(cache.lookupScan(kNativeEncodingEUCKR, "\xb9\xe9", 2, &found));
+    EXPECT_TRUE(cache.lookupScan(kNativeEncodingEUCKR, "\xb0\xed", 2, &found));
+    EXPECT_TRUE(cache.lookupScan(kNativeEncodingEUCKR, "\xc0\xda", 2, &found));
+
+    EXPECT_TRUE(cache.lookupConverted(kNativeEncodingEUCKR, "\xb0\xed", 2) == NULL);
+    cache.storeConverted(kNativeEncodingEUCKR, "\xb0\xed", 2, "\xea\xb3\xa0", 3);
+    EXPECT_STREQ(cache.lookupConverted(kNativeEncodingEUCKR, "\xb0\xed", 2), "\xea\xb3\xa0");
+    EXPECT_EQ(cache.stats().conversionHits, 1u);
+    EXPECT_EQ(cache.stats().conversionMisses, 1u);
+}
+
+// holds any one table, but evicts while going through all of them
+static DetectionCache sDetectionCache(256);
+
+static void enable_tag_converter_with_cache(TestableMediaScannerClient* client)
+{
+    client->setTagConverterEnabled(true);
+    client->setDetectionCache(&sDetectionCache);
+}
+
+TEST(DetectionCacheTest, same_results_as_MediaScannerClient)
+{
+    sDetectionCache.clear();
+    test_same_results(enable_tag_converter_with_cache);
+    // the second file of the same tags is served from the cache.
+    for (int i = 0; i < 2; i++) {
+        __test_same_results(enable_tag_converter_with_cache, strs_EUC_KR,
+                            sizeof(strs_EUC_KR)/sizeof(str_pair), true, "ko");
+    }
+    EXPECT_GT(sDetectionCache.stats().hits, 0u);
+    EXPECT_GT(sDetectionCache.stats().conversionHits, 0u);
+    EXPECT_GT(sDetectionCache.stats().evictions, 0u);
+}
+
+// Latin-1 conversion of native tags opens no converter, and the
+// TagConverter opens each of its converters once per thread, not once per
+// tag.
+TEST_F(MediaScannerClientTest, native_tags_reuse_converters)
+{
+    ConverterCache::releaseThreadCache();
+    test_native_str_pairs(client, strs_windows_1252);
+    EXPECT_EQ(ConverterCache::openCount(), 0);
+
+    client->setTagConverterEnabled(true);
+    client->setLocale("ko");
+    test_native_str_pairs(client, strs_EUC_KR);
+    EXPECT_EQ(ConverterCache::openCount(), 2);
+
+    test_native_str_pairs(client, strs_EUC_KR);
+    EXPECT_EQ(ConverterCache::openCount(), 2);
+
+    ConverterCache::releaseThreadCache();
+    EXPECT_EQ(ConverterCache::openCount(), 0);
+}
+
+// beginFile() drops the results of the previous file but keeps their memory.
+TEST_F(MediaScannerClientTest, results_are_reset_by_beginFile)
+{
+    client->setLocale("ko");
+    test_native_str_pairs(client, strs_EUC_KR);
+    int resultCount = client->getResultCount();
+    size_t capacity = client->getResultCapacity();
+
+    test_native_str_pairs(client, strs_EUC_KR);
+    EXPECT_EQ(client->getResultCount(), resultCount);
+    EXPECT_EQ(client->getResultCapacity(), capacity);
 }
 
 // Some Korean id3 has mix-encoded values. :(
-TEST_F(MediaScannerClientTest, UTF8_and_native_encoding_in_a_id3_tagset)
+static void __test_mixed_encoding_in_a_tagset(TestableMediaScannerClient* client)
 {
     client->setLocale("ko");
 
@@ -279,7 +757,7 @@ TEST_F(MediaScannerClientTest, UTF8_and_native_encoding_in_a_id3_tagset)
 }
 
 // Some Korean id3 is chopped wrongly. :(
-TEST_F(MediaScannerClientTest, native_str_is_chopped_wrongly)
+static void __test_native_str_is_chopped_wrongly(TestableMediaScannerClient* client)
 {
     client->setLocale("ko");
 
@@ -295,7 +773,7 @@ TEST_F(MediaScannerClientTest, native_str_is_chopped_wrongly)
 }
 
 // Sometimes latin-1 strings are decoded as GBK when Locale is "zh_CN"
-TEST_F(MediaScannerClientTest, latin1_str_shouldnt_be_decoded_as_gbk)
+static void __test_latin1_str_shouldnt_be_decoded_as_gbk(TestableMediaScannerClient* client)
 {
     client->setLocale("zh_CN");
 
@@ -310,4 +788,1523 @@ TEST_F(MediaScannerClientTest, latin1_str_shouldnt_be_decoded_as_gbk)
     EXPECT_STREQ(client->getResult(2), "04. W górach zmierzch");
 }
 
+TEST_F(MediaScannerClientTest, UTF8_and_native_encoding_in_a_id3_tagset)
+{
+    __test_mixed_encoding_in_a_tagset(client);
+}
+
+TEST_F(MediaScannerClientTest, native_str_is_chopped_wrongly)
+{
+    __test_native_str_is_chopped_wrongly(client);
+}
+
+TEST_F(MediaScannerClientTest, latin1_str_shouldnt_be_decoded_as_gbk)
+{
+    __test_latin1_str_shouldnt_be_decoded_as_gbk(client);
+}
+
+// the same cases through this tree's TagConverter
+class TagConverterClientTest : public MediaScannerClientTest {
+protected:
+    virtual void SetUp() {
+        MediaScannerClientTest::SetUp();
+        client->setTagConverterEnabled(true);
+    }
+};
+
+TEST_F(TagConverterClientTest, UTF8_and_native_encoding_in_a_id3_tagset)
+{
+    __test_mixed_encoding_in_a_tagset(client);
+}
+
+// the tables through the TagConverter, per tag and batched
+TEST_F(TagConverterClientTest, str_pairs)
+{
+    static const char* locales[] = { "ko", "ja", "zh", "zh_CN" };
+    for (unsigned int l = 0; l < sizeof(locales)/sizeof(locales[0]); l++) {
+        client->setLocale(locales[l]);
+        test_utf8_str_pairs(client, strs_utf_8);
+        test_native_str_pairs(client, strs_windows_1252);
+    }
+
+    client->setLocale("ko");
+    test_native_str_pairs(client, strs_EUC_KR);
+    client->setLocale("ja");
+    test_native_str_pairs(client, strs_SHIFT_JIS);
+    client->setLocale("zh_CN");
+    test_native_str_pairs(client, strs_GB2312);
+    client->setLocale("zh");
+    test_native_str_pairs(client, strs_Big5);
+}
+
+TEST_F(TagConverterClientTest, native_str_is_chopped_wrongly)
+{
+    __test_native_str_is_chopped_wrongly(client);
+}
+
+// a chopped value in the middle of a batch
+TEST_F(TagConverterClientTest, native_str_is_chopped_wrongly_batched)
+{
+    const char* values[] = {
+        "\xb9\xce\xc1\xd6\xb4\xe7\xb4\xe7\xb1\xc7\xc1\xd6\xc0",
+        "ascii",
+        "\xb9\xce\xc1\xd6\xb4\xe7\xb4\xe7\xb1\xc7\xc1\xd6\xc0\xda",
+    };
+    client->setLocale("ko");
+
+    client->beginFile();
+    EXPECT_TRUE(client->addStringTagsWithIdx(values, 3, true));
+    client->endFile();
+
+    EXPECT_STREQ(client->getResult(0), "민주당당권주�");
+    EXPECT_STREQ(client->getResult(1), "ascii");
+    EXPECT_STREQ(client->getResult(2), "민주당당권주자");
+}
+
+TEST_F(TagConverterClientTest, latin1_str_shouldnt_be_decoded_as_gbk)
+{
+    __test_latin1_str_shouldnt_be_decoded_as_gbk(client);
+}
+
+TEST(AlbumEncodingVoteTest, margin)
+{
+    AlbumEncodingVote album(2);
+    EXPECT_EQ(AlbumEncodingVote::kUndecided, album.decision());
+    album.vote(AlbumEncodingVote::kLatin1);
+    album.vote(AlbumEncodingVote::kUndecided);
+    EXPECT_EQ(AlbumEncodingVote::kUndecided, album.decision());
+    album.vote(AlbumEncodingVote::kLatin1);
+    EXPECT_EQ(AlbumEncodingVote::kLatin1, album.decision());
+    album.vote(AlbumEncodingVote::kLocaleEncoding);
+    EXPECT_EQ(AlbumEncodingVote::kUndecided, album.decision());
+    album.vote(AlbumEncodingVote::kLocaleEncoding);
+    album.vote(AlbumEncodingVote::kLocaleEncoding);
+    album.vote(AlbumEncodingVote::kLocaleEncoding);
+    EXPECT_EQ(AlbumEncodingVote::kLocaleEncoding, album.decision());
+
+    EXPECT_EQ(7u, album.stats().files);
+    EXPECT_EQ(1u, album.stats().votes[AlbumEncodingVote::kUndecided]);
+    EXPECT_EQ(2u, album.stats().votes[AlbumEncodingVote::kLatin1]);
+    EXPECT_EQ(4u, album.stats().votes[AlbumEncodingVote::kLocaleEncoding]);
+
+    album.clear();
+    EXPECT_EQ(AlbumEncodingVote::kUndecided, album.decision());
+    EXPECT_EQ(0u, album.stats().files);
+}
+
+// a file of one native tag, its result
+static std::string scan_one_tag(TestableMediaScannerClient* client, const char* native)
+{
+    client->beginFile();
+    client->addNativeStringTagWithIdx(0, native);
+    client->endFile();
+    const char* result = client->getResult(0);
+    return result ? result : "<none>";
+}
+
+// Under ko, "Beyonc\xE9" is EUC-KR chopped after a lead byte, and a two
+// byte title is a hangul syllable. In an album of Latin-1 tracks they
+// follow the album; a track that is well formed EUC-KR doesn't.
+TEST_F(TagConverterClientTest, album_decides_files_that_cant_tell)
+{
+    AlbumEncodingVote album;
+    client->setLocale("ko");
+    EXPECT_EQ("Beyonc\xEF\xBF\xBD", scan_one_tag(client, "Beyonc\xE9"));
+
+    client->setAlbumEncodingVote(&album);
+    EXPECT_EQ("Caf\xC3\xA9 del Mar", scan_one_tag(client, "Caf\xE9 del Mar"));
+    EXPECT_EQ("Bj\xC3\xB6rk", scan_one_tag(client, "Bj\xF6rk"));
+    EXPECT_EQ(AlbumEncodingVote::kUndecided, album.decision());
+    EXPECT_EQ("Sigur R\xC3\xB3s", scan_one_tag(client, "Sigur R\xF3s"));
+    EXPECT_EQ(AlbumEncodingVote::kLatin1, album.decision());
+
+    EXPECT_EQ("Beyonc\xC3\xA9", scan_one_tag(client, "Beyonc\xE9"));
+    EXPECT_EQ("\xC3\x80\xC3\x9A", scan_one_tag(client, "\xC0\xDA"));
+    EXPECT_EQ(strs_EUC_KR[0].utf_8, scan_one_tag(client, strs_EUC_KR[0].native));
+    EXPECT_EQ(3u, album.stats().decidedFiles);
+    EXPECT_EQ(2u, album.stats().followedFiles);
+
+    // a Korean album decides them the other way, which is what a file
+    // alone does.
+    album.clear();
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(strs_EUC_KR[i].utf_8, scan_one_tag(client, strs_EUC_KR[i].native));
+    EXPECT_EQ(AlbumEncodingVote::kLocaleEncoding, album.decision());
+    EXPECT_EQ("\xEC\x9E\x90", scan_one_tag(client, "\xC0\xDA"));
+    __test_native_str_is_chopped_wrongly(client);
+    __test_mixed_encoding_in_a_tagset(client);
+    EXPECT_EQ(3u, album.stats().decidedFiles);
+    EXPECT_EQ(2u, album.stats().followedFiles);
+
+    client->setAlbumEncodingVote(NULL);
+}
+
+// Every native table as an album of files of one tag, under a locale
+// that detects, ends up right at least as often as its files alone,
+// through the per tag and the batched path. Alone, four windows-1252
+// titles are taken for EUC-KR under ko.
+TEST(AlbumEncodingVoteTest, accuracy)
+{
+    const unsigned int tags_per_file = 1;
+    for (unsigned int e = 0; e < enc_table_count; e++) {
+        const enc_table& t = enc_tables[e];
+        if (is_utf8_encoding(t.encoding))
+            continue;
+        const char* locale = native_locale(t.encoding);
+        if (!locale)
+            locale = "ko";
+
+        for (int batched = 0; batched < 2; batched++) {
+            unsigned int right[2] = { 0, 0 };
+            AlbumEncodingVote album;
+            for (int with_album = 0; with_album < 2; with_album++) {
+                TestableMediaScannerClient client;
+                client.setTagConverterEnabled(true);
+                client.setLocale(locale);
+                if (with_album)
+                    client.setAlbumEncodingVote(&album);
+                for (unsigned int first = 0; first < t.size; first += tags_per_file) {
+                    unsigned int count = std::min(tags_per_file, t.size - first);
+                    std::vector<const char*> values;
+                    client.beginFile();
+                    for (unsigned int i = 0; i < count; i++) {
+                        values.push_back(t.table[first + i].native);
+                        if (!batched)
+                            client.addNativeStringTagWithIdx(i, values.back());
+                    }
+                    if (batched) {
+                        EXPECT_TRUE(client.addStringTagsWithIdx(&values[0], count, true));
+                    }
+                    client.endFile();
+                    for (unsigned int i = 0; i < count; i++) {
+                        const char* result = client.getResult(i);
+                        if (result && !strcmp(result, t.table[first + i].utf_8))
+                            right[with_album]++;
+                    }
+                }
+            }
+            printf("album %-12s %-6s %s: %u of %u right alone, %u in an album "
+                   "(%u files followed it)\n", t.encoding, locale,
+                   batched ? "batched" : "per tag", right[0], t.size, right[1],
+                   album.stats().followedFiles);
+            EXPECT_GE(right[1], right[0]) << t.encoding;
+            EXPECT_EQ(t.size, right[1]) << t.encoding;
+        }
+    }
+}
+
+// Files of a few tags taken from a table, scanned by a ScanDriver on 1 to 8
+// threads, must end with the results one client gets scanning them in turn.
+static void __test_scan_driver(client_setup setup, str_pair* table, unsigned int table_size,
+                               bool is_native, const char* locale)
+{
+    const int tags_per_file = 4;
+    std::vector<const char*> values;
+    for (unsigned int i = 0; i < table_size; i++)
+        values.push_back(table[i].native);
+
+    std::vector<ScanDriver::File> files;
+    for (unsigned int i = 0; i < table_size; i++) {
+        ScanDriver::File f;
+        f.values = &values[i];
+        f.valueCount = std::min(tags_per_file, (int)(table_size - i));
+        f.isNative = is_native;
+        files.push_back(f);
+    }
+
+    std::vector<uint64_t> expected;
+    TestableMediaScannerClient client;
+    if (setup)
+        setup(&client);
+    client.setLocale(locale);
+    for (size_t i = 0; i < files.size(); i++) {
+        client.beginFile();
+        for (int j = 0; j < files[i].valueCount; j++) {
+            if (is_native)
+                client.addNativeStringTagWithIdx(j, files[i].values[j]);
+            else
+                client.addStringTagWithIdx(j, files[i].values[j]);
+        }
+        client.endFile();
+
+        std::vector<const char*> results;
+        for (int j = 0; j < client.getResultCount(); j++)
+            results.push_back(client.getResult(j));
+        expected.push_back(ScanDriver::digest(results.empty() ? NULL : &results[0],
+                                              results.size()));
+    }
+
+    ScanDriver driver(locale, setup);
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        ScanDriver::Result result;
+        ASSERT_EQ(OK, driver.run(files, threads, &result));
+        ASSERT_EQ(files.size(), result.fileCount);
+        for (size_t i = 0; i < files.size(); i++)
+            EXPECT_EQ(expected[i], result.digests[i]) << "file " << i << " threads " << threads;
+    }
+}
+
+static void test_scan_driver(client_setup setup)
+{
+    __test_scan_driver(setup, strs_utf_8, sizeof(strs_utf_8)/sizeof(str_pair), false, "ko");
+    __test_scan_driver(setup, strs_windows_1252, sizeof(strs_windows_1252)/sizeof(str_pair), true, "ko");
+    __test_scan_driver(setup, strs_EUC_KR, sizeof(strs_EUC_KR)/sizeof(str_pair), true, "ko");
+    __test_scan_driver(setup, strs_SHIFT_JIS, sizeof(strs_SHIFT_JIS)/sizeof(str_pair), true, "ja");
+    __test_scan_driver(setup, strs_GB2312, sizeof(strs_GB2312)/sizeof(str_pair), true, "zh_CN");
+    __test_scan_driver(setup, strs_Big5, sizeof(strs_Big5)/sizeof(str_pair), true, "zh");
+}
+
+TEST(ScanDriverTest, same_results_on_every_thread_count)
+{
+    test_scan_driver(NULL);
+}
+
+TEST(ScanDriverTest, same_results_on_every_thread_count_with_tag_converter)
+{
+    test_scan_driver(enable_tag_converter);
+}
+
+// Files of a test are named by the process, so that the shards of
+// run_tests.sh don't step on each other.
+static std::string corpus_path(const char* name)
+{
+    const char* dir = getenv("TMPDIR");
+    char pid[16];
+    snprintf(pid, sizeof(pid), "%d.", (int)getpid());
+    return std::string(dir ? dir : "/data/local/tmp") + "/" + pid + name;
+}
+
+// Writes testee.h as make_testee.py writes testee.bin; see TesteeCorpus.h.
+static bool write_corpus(const char* path)
+{
+    std::vector<uint32_t> fields;
+    std::string strings;
+
+    uint32_t index_offset = 16 + 16 * enc_table_count;
+    uint32_t item_count = 0;
+    for (unsigned int e = 0; e < enc_table_count; e++)
+        item_count += enc_tables[e].size;
+    uint32_t string_offset = index_offset + 16 * item_count;
+
+    std::vector<uint32_t> index;
+    for (unsigned int e = 0; e < enc_table_count; e++) {
+        const enc_table& t = enc_tables[e];
+        fields.push_back(string_offset + strings.size());
+        strings.append(t.encoding, strlen(t.encoding) + 1);
+        fields.push_back(t.size);
+        fields.push_back(index_offset + 16 * (index.size() / 4));
+        fields.push_back(0);
+        for (unsigned int i = 0; i < t.size; i++) {
+            const char* strs[2] = { t.table[i].native, t.table[i].utf_8 };
+            for (int k = 0; k < 2; k++) {
+                index.push_back(string_offset + strings.size());
+                index.push_back(strlen(strs[k]));
+                strings.append(strs[k], strlen(strs[k]) + 1);
+            }
+        }
+    }
+
+    uint32_t header[4] = { TesteeCorpus::kMagic, TesteeCorpus::kVersion, enc_table_count,
+                           (uint32_t)(string_offset + strings.size()) };
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+    fwrite(header, sizeof(header), 1, fp);
+    fwrite(&fields[0], sizeof(uint32_t), fields.size(), fp);
+    fwrite(&index[0], sizeof(uint32_t), index.size(), fp);
+    fwrite(strings.data(), 1, strings.size(), fp);
+    return fclose(fp) == 0;
+}
+
+TEST(TesteeCorpusTest, reads_what_was_written)
+{
+    std::string path = corpus_path("TesteeCorpusTest.bin");
+    ASSERT_TRUE(write_corpus(path.c_str()));
+
+    TesteeCorpus corpus;
+    ASSERT_EQ(OK, corpus.open(path.c_str()));
+    ASSERT_EQ((int)enc_table_count, corpus.encodingCount());
+    for (unsigned int e = 0; e < enc_table_count; e++) {
+        const enc_table& t = enc_tables[e];
+        int enc = corpus.findEncoding(t.encoding);
+        ASSERT_EQ((int)e, enc);
+        EXPECT_STREQ(t.encoding, corpus.encodingName(enc));
+        ASSERT_EQ(t.size, corpus.itemCount(enc));
+        for (unsigned int i = 0; i < t.size; i++) {
+            size_t len;
+            EXPECT_STREQ(t.table[i].native, corpus.native(enc, i, &len));
+            EXPECT_EQ(strlen(t.table[i].native), len);
+            EXPECT_STREQ(t.table[i].utf_8, corpus.utf8(enc, i, &len));
+            EXPECT_EQ(strlen(t.table[i].utf_8), len);
+        }
+        EXPECT_TRUE(corpus.native(enc, t.size) == NULL);
+    }
+    EXPECT_EQ(-1, corpus.findEncoding("EUC-JP"));
+    size_t len = 7;
+    EXPECT_TRUE(corpus.native(enc_table_count, 0, &len) == NULL);
+    EXPECT_EQ(0u, len);
+    corpus.close();
+
+    // the first native string's offset moved past the end of the file
+    FILE* fp = fopen(path.c_str(), "r+b");
+    ASSERT_TRUE(fp != NULL);
+    uint32_t offset = 0xFFFFFF00;
+    fseek(fp, 16 + 16 * enc_table_count, SEEK_SET);
+    fwrite(&offset, sizeof(offset), 1, fp);
+    fclose(fp);
+    ASSERT_EQ(OK, corpus.open(path.c_str()));
+    len = 7;
+    EXPECT_TRUE(corpus.native(0, 0, &len) == NULL);
+    EXPECT_EQ(0u, len);
+    EXPECT_STREQ(enc_tables[0].table[0].utf_8, corpus.utf8(0, 0, &len));
+    EXPECT_EQ(strlen(enc_tables[0].table[0].utf_8), len);
+
+    corpus.close();
+    unlink(path.c_str());
+}
+
+TEST(TesteeCorpusTest, rejects_broken_files)
+{
+    std::string path = corpus_path("TesteeCorpusTest.bin");
+    TesteeCorpus corpus;
+
+    unlink(path.c_str());
+    EXPECT_EQ(NAME_NOT_FOUND, corpus.open(path.c_str()));
+
+    // cut short, so the size in the header is wrong
+    ASSERT_TRUE(write_corpus(path.c_str()));
+    ASSERT_EQ(0, truncate(path.c_str(), 100));
+    EXPECT_EQ(BAD_VALUE, corpus.open(path.c_str()));
+    EXPECT_FALSE(corpus.isOpen());
+
+    // not a corpus
+    FILE* fp = fopen(path.c_str(), "wb");
+    ASSERT_TRUE(fp != NULL);
+    fputs("struct str_pair {\n    const char *native;\n};\n", fp);
+    fclose(fp);
+    EXPECT_EQ(BAD_VALUE, corpus.open(path.c_str()));
+
+    unlink(path.c_str());
+}
+
+// A locale that detects, for the corpus: a native encoding's own, and ko
+// for the others so detection has to leave them alone.
+static const char* detecting_locale(const char* encoding)
+{
+    const char* locale = native_locale(encoding);
+    return locale || is_utf8_encoding(encoding) ? locale : "ko";
+}
+
+// Every string of a corpus in files of 50 tags, as the testee.h tables
+// are, must be converted to its utf-8. The corpus is $TESTEE_CORPUS when
+// set, say a large testee.bin from make_testee.py pushed to the device,
+// else testee.h written as a corpus.
+//
+// The files are dealt to kCorpusSlices tests, so that shards of the test
+// binary share a large corpus out.
+class TesteeCorpusSliceTest : public testing::TestWithParam<int> {
+public:
+    enum { kCorpusSlices = 16 };
+};
+
+TEST_P(TesteeCorpusSliceTest, MediaScannerClient_converts_corpus)
+{
+    const unsigned int tags_per_file = 50;
+    const uint32_t slice = GetParam();
+    std::string path = corpus_path("TesteeCorpusTest.bin");
+    const char* env = getenv("TESTEE_CORPUS");
+    if (env)
+        path = env;
+    else
+        ASSERT_TRUE(write_corpus(path.c_str()));
+
+    TesteeCorpus corpus;
+    ASSERT_EQ(OK, corpus.open(path.c_str()));
+    for (int enc = 0; enc < corpus.encodingCount(); enc++) {
+        const char* encoding = corpus.encodingName(enc);
+        bool is_native = !is_utf8_encoding(encoding);
+
+        TestableMediaScannerClient client;
+        const char* locale = detecting_locale(encoding);
+        if (locale)
+            client.setLocale(locale);
+        uint32_t stride = tags_per_file * kCorpusSlices;
+        for (uint32_t first = slice * tags_per_file; first < corpus.itemCount(enc);
+             first += stride) {
+            uint32_t count = std::min(tags_per_file, corpus.itemCount(enc) - first);
+            client.beginFile();
+            for (uint32_t i = 0; i < count; i++) {
+                if (is_native)
+                    client.addNativeStringTagWithIdx(i, corpus.native(enc, first + i));
+                else
+                    client.addStringTagWithIdx(i, corpus.native(enc, first + i));
+            }
+            client.endFile();
+
+            for (uint32_t i = 0; i < count; i++)
+                EXPECT_STREQ(corpus.utf8(enc, first + i), client.getResult(i))
+                    << encoding << " item " << first + i;
+        }
+    }
+
+    corpus.close();
+    if (!env)
+        unlink(path.c_str());
+}
+
+INSTANTIATE_TEST_SUITE_P(testee, TesteeCorpusSliceTest,
+                         testing::Range(0, (int)TesteeCorpusSliceTest::kCorpusSlices));
+
+static std::string icu_to_utf8(const char* charset, const char* src, size_t len)
+{
+    if (len == 0)
+        return std::string();
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter* conv = ConverterCache::get(charset, &status);
+    UConverter* utf8Conv = ConverterCache::get("UTF-8", &status);
+    std::vector<char> out(len * 3 + 1);
+    char* target = &out[0];
+    ucnv_convertEx(utf8Conv, conv, &target, target + out.size(),
+                   &src, src + len, NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
+    EXPECT_TRUE(U_SUCCESS(status)) << charset;
+    return std::string(&out[0], target - &out[0]);
+}
+
+static void expect_same_as_icu(const char* src, size_t len)
+{
+    std::vector<char> out(len * 3 + 1);
+    char* end = latin1ToUtf8(src, len, &out[0]);
+    EXPECT_EQ(icu_to_utf8("iso_8859_1", src, len), std::string(&out[0], end - &out[0]));
+    end = windows1252ToUtf8(src, len, &out[0]);
+    EXPECT_EQ(icu_to_utf8("windows-1252", src, len), std::string(&out[0], end - &out[0]));
+}
+
+TEST(Latin1Utf8Test, same_as_icu)
+{
+    // every byte, alone and at every offset of a block
+    char block[80];
+    for (int c = 1; c < 256; c++) {
+        char b = c;
+        expect_same_as_icu(&b, 1);
+        memset(block, 'a', sizeof(block));
+        for (size_t at = 0; at < sizeof(block); at += 7) {
+            block[at] = c;
+            expect_same_as_icu(block, sizeof(block));
+        }
+    }
+
+    // random bytes, mostly ASCII or not, of every length up to 100
+    srand(1252);
+    std::vector<char> bytes;
+    for (int i = 0; i < 2000; i++) {
+        bytes.resize(rand() % 101);
+        int highPercent = (i % 4) * 30;
+        for (size_t k = 0; k < bytes.size(); k++) {
+            bytes[k] = rand() % 100 < highPercent ? 0x80 | rand() : 1 + rand() % 0x7F;
+        }
+        expect_same_as_icu(bytes.empty() ? NULL : &bytes[0], bytes.size());
+    }
+
+    // the native strings of the corpus, as in TesteeCorpusTest
+    std::string path = corpus_path("Latin1Utf8Test.bin");
+    const char* env = getenv("TESTEE_CORPUS");
+    if (env)
+        path = env;
+    else
+        ASSERT_TRUE(write_corpus(path.c_str()));
+    TesteeCorpus corpus;
+    ASSERT_EQ(OK, corpus.open(path.c_str()));
+    for (int enc = 0; enc < corpus.encodingCount(); enc++) {
+        for (uint32_t i = 0; i < corpus.itemCount(enc); i++) {
+            const char* native = corpus.native(enc, i);
+            expect_same_as_icu(native, strlen(native));
+        }
+    }
+    corpus.close();
+    if (!env)
+        unlink(path.c_str());
+
+    // and windows-1252 is what the corpus has it converted to
+    std::vector<char> out;
+    for (size_t i = 0; i < sizeof(strs_windows_1252)/sizeof(str_pair); i++) {
+        const char* native = strs_windows_1252[i].native;
+        out.resize(strlen(native) * 3 + 1);
+        *windows1252ToUtf8(native, strlen(native), &out[0]) = 0;
+        EXPECT_STREQ(strs_windows_1252[i].utf_8, &out[0]);
+    }
+}
+
+// utf8 as ID3v2 has UTF-16: big or little endian, with a BOM or not,
+// and ended by a zero code unit or not.
+static std::string to_utf16(const char* utf8, bool is_big_endian, bool has_bom, bool has_zero)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter* conv = ConverterCache::get(is_big_endian ? "UTF-16BE" : "UTF-16LE", &status);
+    UConverter* utf8Conv = ConverterCache::get("UTF-8", &status);
+    size_t len = strlen(utf8);
+    std::vector<char> out(len * 4 + 2);
+    char* target = &out[0];
+    const char* src = utf8;
+    if (len > 0) {
+        ucnv_convertEx(conv, utf8Conv, &target, target + out.size(),
+                       &src, src + len, NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
+    }
+    EXPECT_TRUE(U_SUCCESS(status));
+
+    std::string utf16;
+    if (has_bom)
+        utf16 = is_big_endian ? "\xFE\xFF" : "\xFF\xFE";
+    utf16.append(&out[0], target - &out[0]);
+    if (has_zero)
+        utf16.append(2, '\0');
+    return utf16;
+}
+
+static std::string utf16_to_utf8(const std::string& utf16, Utf16ByteOrder order)
+{
+    std::vector<char> out(utf16Utf8Bound(utf16.size()));
+    char* end = utf16ToUtf8(utf16.data(), utf16.size(), order, &out[0]);
+    EXPECT_LE(end - &out[0], (ptrdiff_t)out.size());
+    return std::string(&out[0], end - &out[0]);
+}
+
+TEST(Utf16Utf8Test, same_as_icu)
+{
+    // random code units, ASCII, BMP and surrogates, paired or not, and
+    // odd lengths; no zero, which would end the value.
+    srand(16);
+    std::string bytes;
+    for (int i = 0; i < 2000; i++) {
+        bytes.clear();
+        int units = rand() % 60;
+        for (int k = 0; k < units; k++) {
+            int r = rand() % 10;
+            uint32_t c;
+            if (r < 6)
+                c = 1 + rand() % 0x7F;
+            else if (r < 8)
+                c = 0x80 + rand() % (0xD800 - 0x80);
+            else if (r < 9)
+                c = 0xD800 + rand() % 0x800;
+            else
+                c = 0xE000 + rand() % 0x2000;
+            if (c == 0xFEFF || c == 0xFFFE)
+                c = 'x';    // a BOM at the start is dropped
+            bytes += (char)(c >> 8);
+            bytes += (char)c;
+        }
+        if (i % 5 == 0)
+            bytes += 'z';
+
+        std::string swapped = bytes;
+        for (size_t k = 0; k + 1 < swapped.size(); k += 2)
+            std::swap(swapped[k], swapped[k + 1]);
+        EXPECT_EQ(icu_to_utf8("UTF-16BE", bytes.data(), bytes.size()),
+                  utf16_to_utf8(bytes, kUtf16BigEndian)) << i;
+        EXPECT_EQ(icu_to_utf8("UTF-16LE", swapped.data(), swapped.size()),
+                  utf16_to_utf8(swapped, kUtf16LittleEndian)) << i;
+    }
+}
+
+TEST(Utf16Utf8Test, bom_and_zero)
+{
+    const char* value = "Caf\xC3\xA9 \xEC\x9B\x90\xEB\x8D\x94 \xF0\x9D\x84\x9E";
+    for (int k = 0; k < 8; k++) {
+        bool is_big_endian = k & 1, has_bom = k & 2, has_zero = k & 4;
+        std::string utf16 = to_utf16(value, is_big_endian, has_bom, has_zero);
+        // the BOM wins over the order given
+        Utf16ByteOrder order = is_big_endian != has_bom ? kUtf16BigEndian : kUtf16LittleEndian;
+        EXPECT_EQ(value, utf16_to_utf8(utf16, order)) << k;
+        utf16 += "\0x";
+        if (has_zero) {
+            EXPECT_EQ(value, utf16_to_utf8(utf16, order)) << k;
+        }
+    }
+    EXPECT_EQ("", utf16_to_utf8(std::string(), kUtf16BigEndian));
+    EXPECT_EQ("", utf16_to_utf8(std::string("\xFF\xFE", 2), kUtf16BigEndian));
+}
+
+// The utf-8 tables as UTF-16 come out as they are, with no detection:
+// windows-1252 under ko would otherwise be taken for EUC-KR.
+static void __test_utf16_str_pairs(TestableMediaScannerClient* client)
+{
+    static str_pair* tables[] = { strs_utf_8, strs_windows_1252 };
+    static const unsigned int sizes[] = {
+        sizeof(strs_utf_8)/sizeof(str_pair), sizeof(strs_windows_1252)/sizeof(str_pair) };
+
+    client->setLocale("ko");
+    for (unsigned int t = 0; t < 2; t++) {
+        for (int k = 0; k < 8; k++) {
+            bool is_big_endian = k & 1, has_bom = k & 2, has_zero = k & 4;
+            Utf16ByteOrder order = has_bom || is_big_endian ? kUtf16BigEndian
+                                                            : kUtf16LittleEndian;
+            std::vector<std::string> values;
+            for (unsigned int i = 0; i < sizes[t]; i++)
+                values.push_back(to_utf16(tables[t][i].utf_8, is_big_endian, has_bom, has_zero));
+
+            client->beginFile();
+            for (unsigned int i = 0; i < sizes[t]; i++)
+                EXPECT_TRUE(client->addUtf16StringTagWithIdx(i, values[i].data(),
+                                                             values[i].size(), order));
+            client->endFile();
+
+            ASSERT_EQ((int)sizes[t], client->getResultCount());
+            for (unsigned int i = 0; i < sizes[t]; i++)
+                EXPECT_STREQ(tables[t][i].utf_8, client->getResult(i)) << t << " " << k;
+        }
+    }
+}
+
+TEST_F(MediaScannerClientTest, UTF16)
+{
+    __test_utf16_str_pairs(client);
+}
+
+TEST_F(TagConverterClientTest, UTF16)
+{
+    __test_utf16_str_pairs(client);
+    client->setTagViewEnabled(true);
+    __test_utf16_str_pairs(client);
+}
+
+// Records what Id3Reader hands over, as "ID:encoding:text".
+class Id3TextRecorder : public Id3TextHandler {
+public:
+    std::vector<std::string> texts;
+
+    virtual status_t handleId3Text(const char* frameId, Id3TextEncoding encoding,
+                                   const char* text, size_t length) {
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "%s:%d:", frameId, encoding);
+        texts.push_back(prefix + std::string(text, length));
+        return OK;
+    }
+};
+
+TEST(Id3ReaderTest, frames)
+{
+    SyntheticMp3 mp3;
+    std::vector<char> data;
+    Id3TextRecorder recorder;
+
+    for (int version = 3; version <= 4; version++) {
+        mp3.clear();
+        mp3.setId3v2Version(version);
+        mp3.addTextFrame("TIT2", kId3Latin1, "Title", 5);
+        mp3.addTextFrame("TXXX", kId3Latin1, "skipped", 7);
+        mp3.addTextFrame("TALB", kId3Utf8, "Album\0", 6);
+        mp3.setAudioSize(1000);
+        mp3.setId3v1("v1 title", "", "", "");
+        mp3.build(&data);
+        recorder.texts.clear();
+        EXPECT_EQ(OK, Id3Reader::parse(&data[0], data.size(), &recorder));
+        ASSERT_EQ(2u, recorder.texts.size());
+        EXPECT_EQ("TIT2:0:Title", recorder.texts[0]);
+        EXPECT_EQ(std::string("TALB:3:Album\0", 13), recorder.texts[1]);
+    }
+
+    // ID3v1 alone, trimmed, with the ID3v2.3 IDs
+    mp3.clear();
+    mp3.setAudioSize(1000);
+    mp3.setId3v1("Title  ", "Artist", "", "2010");
+    mp3.build(&data);
+    recorder.texts.clear();
+    EXPECT_EQ(OK, Id3Reader::parse(&data[0], data.size(), &recorder));
+    ASSERT_EQ(3u, recorder.texts.size());
+    EXPECT_EQ("TIT2:0:Title", recorder.texts[0]);
+    EXPECT_EQ("TPE1:0:Artist", recorder.texts[1]);
+    EXPECT_EQ("TYER:0:2010", recorder.texts[2]);
+
+    // ID3v2.2, a compressed ID3v2.3 frame and a frame past the tag
+    static const char v22[] = "ID3\x02\x00\x00\x00\x00\x00\x0A"
+                              "TT2\x00\x00\x04\x00" "abc";
+    recorder.texts.clear();
+    EXPECT_EQ(OK, Id3Reader::parse(v22, sizeof(v22) - 1, &recorder));
+    ASSERT_EQ(1u, recorder.texts.size());
+    EXPECT_EQ("TIT2:0:abc", recorder.texts[0]);
+
+    static const char v23[] = "ID3\x03\x00\x00\x00\x00\x00\x1E"
+                              "TIT2\x00\x00\x00\x04\x00\x80\x00" "abc"
+                              "TPE1\x00\x00\x01\x00\x00\x00\x00" "abc";
+    recorder.texts.clear();
+    EXPECT_EQ(OK, Id3Reader::parse(v23, sizeof(v23) - 1, &recorder));
+    EXPECT_EQ(0u, recorder.texts.size());
+}
+
+static std::string tag_value(TestableMediaScannerClient* client, const char* name)
+{
+    for (int i = 0; i < client->getResultCount(); i++) {
+        const char* n = client->getTagName(client->getResultId(i));
+        if (n && !strcmp(n, name))
+            return client->getResult(i);
+    }
+    return "<none>";
+}
+
+// Native, UTF-16 and UTF-8 frames of a file written to disk come back
+// from scanFile() converted, through either client path.
+static void __test_scan_file(TestableMediaScannerClient* client)
+{
+    std::string path = corpus_path("ScanFileTest.mp3");
+    std::string artist = to_utf16(strs_utf_8[1].utf_8, false, true, true);
+
+    for (int version = 3; version <= 4; version++) {
+        SyntheticMp3 mp3;
+        mp3.setId3v2Version(version);
+        mp3.addTextFrame("TIT2", kId3Latin1, strs_EUC_KR[0].native, strlen(strs_EUC_KR[0].native));
+        mp3.addTextFrame("TPE1", kId3Utf16, artist.data(), artist.size());
+        mp3.addTextFrame("TALB", kId3Utf8, strs_utf_8[2].utf_8, strlen(strs_utf_8[2].utf_8));
+        mp3.addTextFrame("TYER", kId3Latin1, "2010", 4);
+        mp3.setAudioSize(4096);
+        mp3.setId3v1("ignored", "ignored", "ignored", "1999");
+        ASSERT_EQ(OK, mp3.write(path.c_str()));
+
+        client->setLocale("ko");
+        ASSERT_EQ(OK, client->scanFile(path.c_str(), 0, 0, false, false));
+        EXPECT_EQ(4, client->getResultCount());
+        EXPECT_EQ(strs_EUC_KR[0].utf_8, tag_value(client, "title"));
+        EXPECT_EQ(strs_utf_8[1].utf_8, tag_value(client, "artist"));
+        EXPECT_EQ(strs_utf_8[2].utf_8, tag_value(client, "album"));
+        EXPECT_EQ("2010", tag_value(client, "year"));
+    }
+
+    EXPECT_EQ(NAME_NOT_FOUND, client->scanFile("/nonexistent.mp3", 0, 0, false, false));
+    unlink(path.c_str());
+}
+
+TEST_F(MediaScannerClientTest, scanFile)
+{
+    __test_scan_file(client);
+}
+
+TEST_F(TagConverterClientTest, scanFile)
+{
+    __test_scan_file(client);
+}
+
+// TYER and TDRC are both "year"; a file with both gets both.
+static void __test_scan_file_same_names(TestableMediaScannerClient* client)
+{
+    std::string path = corpus_path("ScanFileSameNamesTest.mp3");
+    SyntheticMp3 mp3;
+    mp3.setId3v2Version(4);
+    mp3.addTextFrame("TYER", kId3Latin1, "2010", 4);
+    mp3.addTextFrame("TIT2", kId3Latin1, "Title", 5);
+    mp3.addTextFrame("TDRC", kId3Latin1, "2011", 4);
+    mp3.setAudioSize(1024);
+    ASSERT_EQ(OK, mp3.write(path.c_str()));
+
+    client->setLocale("ko");
+    ASSERT_EQ(OK, client->scanFile(path.c_str(), 0, 0, false, false));
+    std::vector<std::string> years;
+    for (int i = 0; i < client->getResultCount(); i++) {
+        const char* name = client->getTagName(client->getResultId(i));
+        if (name && !strcmp(name, "year"))
+            years.push_back(client->getResult(i));
+    }
+    ASSERT_EQ(2u, years.size());
+    EXPECT_EQ("2010", years[0]);
+    EXPECT_EQ("2011", years[1]);
+    EXPECT_EQ(3, client->getResultCount());
+    unlink(path.c_str());
+}
+
+TEST_F(MediaScannerClientTest, scanFile_same_names)
+{
+    __test_scan_file_same_names(client);
+}
+
+TEST_F(TagConverterClientTest, scanFile_same_names)
+{
+    __test_scan_file_same_names(client);
+}
+
+struct spsc_counts {
+    SpscQueue* queue;
+    uintptr_t count;
+};
+
+static void* spsc_producer(void* arg)
+{
+    spsc_counts* c = static_cast<spsc_counts*>(arg);
+    for (uintptr_t i = 1; i <= c->count; i++) {
+        for (int round = 0; !c->queue->push((void*)i); round++)
+            SpscQueue::wait(round);
+    }
+    return NULL;
+}
+
+// Everything pushed on one thread is popped on another, once and in order.
+TEST(SpscQueueTest, in_order_across_threads)
+{
+    SpscQueue queue(3);
+    EXPECT_EQ(4u, queue.capacity());
+
+    spsc_counts counts = { &queue, 200000 };
+    pthread_t producer;
+    ASSERT_EQ(0, pthread_create(&producer, NULL, spsc_producer, &counts));
+    uintptr_t expected = 1;
+    while (expected <= counts.count) {
+        void* item;
+        for (int round = 0; !queue.pop(&item); round++)
+            SpscQueue::wait(round);
+        ASSERT_EQ(expected, (uintptr_t)item);
+        expected++;
+    }
+    pthread_join(producer, NULL);
+
+    void* item;
+    EXPECT_FALSE(queue.pop(&item));
+    for (int i = 0; i < 4; i++)
+        EXPECT_TRUE(queue.push(NULL));
+    EXPECT_FALSE(queue.push(NULL));
+}
+
+// Records the tags a ScanPipeline delivers, as "name=value".
+class TagRecorder : public MediaScannerClient {
+public:
+    std::vector<std::string> tags;
+
+    virtual status_t handleStringTag(const char* name, const char* value) {
+        tags.push_back(std::string(name) + "=" + value);
+        return OK;
+    }
+
+    virtual status_t scanFile(const char* path, long long lastModified,
+                              long long fileSize, bool isDirectory, bool noMedia) {
+        return OK;
+    }
+
+    virtual status_t setMimeType(const char* mimeType) {
+        return OK;
+    }
+};
+
+// Files scanned by a ScanPipeline, on 1 to 4 workers with 1 or 2 files
+// each in flight, must give the tags scanFile() gives, in file order.
+static void test_scan_pipeline(client_setup setup)
+{
+    const int file_count = 24;
+    std::vector<std::string> paths;
+    std::vector<std::string> expected;
+    std::vector<uint64_t> digests;
+    TestableMediaScannerClient client;
+    if (setup)
+        setup(&client);
+    client.setLocale("ko");
+
+    for (int i = 0; i < file_count; i++) {
+        const str_pair& title = strs_EUC_KR[i % (sizeof(strs_EUC_KR)/sizeof(str_pair))];
+        const str_pair& album = strs_utf_8[i % (sizeof(strs_utf_8)/sizeof(str_pair))];
+        std::string artist = to_utf16(album.utf_8, i % 2, true, false);
+        SyntheticMp3 mp3;
+        mp3.setId3v2Version(3 + i % 2);
+        mp3.addTextFrame("TIT2", kId3Latin1, title.native, strlen(title.native));
+        mp3.addTextFrame("TPE1", kId3Utf16, artist.data(), artist.size());
+        mp3.addTextFrame("TALB", kId3Utf8, album.utf_8, strlen(album.utf_8));
+        mp3.setAudioSize(1024);
+        char name[32];
+        snprintf(name, sizeof(name), "ScanPipelineTest%d.mp3", i);
+        paths.push_back(corpus_path(name));
+        ASSERT_EQ(OK, mp3.write(paths.back().c_str()));
+
+        ASSERT_EQ(OK, client.scanFile(paths.back().c_str(), 0, 0, false, false));
+        std::vector<const char*> values;
+        for (int j = 0; j < client.getResultCount(); j++) {
+            values.push_back(client.getResult(j));
+            expected.push_back(std::string(client.getTagName(client.getResultId(j))) +
+                               "=" + values.back());
+        }
+        digests.push_back(ScanDriver::digest(&values[0], values.size()));
+    }
+
+    for (int workers = 1; workers <= 4; workers *= 2) {
+        for (int depth = 1; depth <= 2; depth++) {
+            TagRecorder recorder;
+            std::vector<uint64_t> results;
+            ScanPipeline pipeline(&recorder, "ko", setup);
+            pipeline.setDigests(&results);
+            ASSERT_EQ(OK, pipeline.start(workers, depth));
+            for (int i = 0; i < file_count; i++)
+                EXPECT_EQ(OK, pipeline.scanFile(paths[i].c_str()));
+            EXPECT_EQ(NAME_NOT_FOUND, pipeline.scanFile("/nonexistent.mp3"));
+            EXPECT_EQ(NAME_NOT_FOUND, pipeline.finish());
+
+            EXPECT_TRUE(expected == recorder.tags) << workers << " workers, depth " << depth;
+            ASSERT_EQ((size_t)file_count, results.size());
+            for (int i = 0; i < file_count; i++)
+                EXPECT_EQ(digests[i], results[i]) << "file " << i;
+        }
+    }
+
+    for (int i = 0; i < file_count; i++)
+        unlink(paths[i].c_str());
+}
+
+TEST(ScanPipelineTest, same_results_as_scanFile)
+{
+    test_scan_pipeline(NULL);
+}
+
+TEST(ScanPipelineTest, same_results_as_scanFile_with_tag_converter)
+{
+    test_scan_pipeline(enable_tag_converter);
+}
+
+// Time from a new client to its first endFile() of table under locale,
+// as the first file after boot: no converter open, no ICU data loaded.
+// mode 0 doesn't warm up, 1 does in the foreground before the file, 2
+// starts a background warm-up and goes on with the file.
+static nsecs_t time_to_first_endFile(client_setup setup, str_pair* table, unsigned int size,
+                                     const char* locale, int mode, nsecs_t* warm_up)
+{
+    ConverterCache::releaseThreadCache();
+    ucnv_flushCache();
+
+    TestableMediaScannerClient client;
+    if (setup)
+        setup(&client);
+    client.setLocale(locale);
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (mode) {
+        EXPECT_EQ(OK, client.warmUp(mode == 2));
+    }
+    *warm_up = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    client.beginFile();
+    for (unsigned int i = 0; i < size; i++)
+        client.addNativeStringTagWithIdx(i, table[i].native);
+    client.endFile();
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    client.waitForWarmUp();
+    for (unsigned int i = 0; i < size; i++)
+        EXPECT_STREQ(table[i].utf_8, client.getResult(i)) << locale << " " << i;
+    return elapsed;
+}
+
+static void test_warm_up(const char* path, client_setup setup)
+{
+    static str_pair* tables[] = { strs_EUC_KR, strs_SHIFT_JIS, strs_Big5, strs_GB2312 };
+    static const unsigned int sizes[] = {
+        sizeof(strs_EUC_KR)/sizeof(str_pair), sizeof(strs_SHIFT_JIS)/sizeof(str_pair),
+        sizeof(strs_Big5)/sizeof(str_pair), sizeof(strs_GB2312)/sizeof(str_pair) };
+    static const char* locales[] = { "ko", "ja", "zh", "zh_CN" };
+
+    for (unsigned int l = 0; l < sizeof(locales)/sizeof(locales[0]); l++) {
+        nsecs_t first[3], warm_up[3];
+        for (int mode = 0; mode < 3; mode++)
+            first[mode] = time_to_first_endFile(setup, tables[l], sizes[l], locales[l],
+                                                mode, &warm_up[mode]);
+        printf("first endFile %-13s %-6s cold %8.1f us  warmed up %8.1f us (+%8.1f us)  "
+               "background %8.1f us\n", path, locales[l],
+               nsToUs(first[0]), nsToUs(first[1]), nsToUs(warm_up[1]), nsToUs(first[2]));
+    }
+    ConverterCache::releaseThreadCache();
+}
+
+TEST(WarmUpTest, time_to_first_endFile)
+{
+    test_warm_up("libmedia", NULL);
+    test_warm_up("TagConverter", enable_tag_converter);
+}
+
+// A foreground warm-up leaves nothing for the TagConverter to open; a
+// background one leaves the data loaded for ucnv_flushCache() to drop.
+TEST(WarmUpTest, opens_the_locale_converters)
+{
+    ConverterCache::releaseThreadCache();
+    TestableMediaScannerClient client;
+    client.setTagConverterEnabled(true);
+    EXPECT_EQ(OK, client.warmUp());
+    EXPECT_EQ(0, ConverterCache::openCount());
+
+    client.setLocale("ko");
+    EXPECT_EQ(OK, client.warmUp());
+    EXPECT_EQ(2, ConverterCache::openCount());
+    test_native_str_pairs(&client, strs_EUC_KR);
+    EXPECT_EQ(2, ConverterCache::openCount());
+
+    ConverterCache::releaseThreadCache();
+    ucnv_flushCache();
+    client.setLocale("ja");
+    EXPECT_EQ(OK, client.warmUp(true));
+    client.waitForWarmUp();
+    EXPECT_EQ(0, ConverterCache::openCount());
+    EXPECT_GE(ucnv_flushCache(), 1);
+}
+
+// With SCAN_STATS the counters of one file add up to what it went
+// through, and the files add up in the totals. Without, nothing counts.
+TEST(ScanStatsTest, counts_a_file)
+{
+    ScanStats* stats = ScanStats::thread();
+    uint32_t files = stats->total().files;
+    const unsigned int size = sizeof(strs_EUC_KR)/sizeof(str_pair);
+
+    TestableMediaScannerClient client;
+    client.setTagConverterEnabled(true);
+    client.setLocale("ko");
+    __test_str_pairs(&client, strs_EUC_KR, size, true);
+    ScanCounters euc_kr = stats->file();
+    __test_str_pairs(&client, strs_windows_1252,
+                     sizeof(strs_windows_1252)/sizeof(str_pair), true);
+    ScanCounters latin1 = stats->file();
+
+#if SCAN_STATS_ENABLED
+    EXPECT_EQ(1u, euc_kr.files);
+    EXPECT_EQ(size, euc_kr.tags);
+    EXPECT_GT(euc_kr.detectedTags, 0u);
+    EXPECT_GE(euc_kr.candidateEncodings, euc_kr.detectedTags);
+    EXPECT_GT(euc_kr.bytesConverted, 0u);
+    EXPECT_EQ(0u, euc_kr.latin1Fallbacks);
+    EXPECT_GT(euc_kr.addStringTagNs, 0u);
+    EXPECT_GT(euc_kr.endFileNs, 0u);
+    EXPECT_GT(euc_kr.handleStringTagNs, 0u);
+    EXPECT_GT(latin1.latin1Fallbacks, 0u);
+    // __test_str_pairs() scans the table per tag and batched
+    EXPECT_EQ(files + 4, stats->total().files);
+#else
+    EXPECT_EQ(0u, euc_kr.files);
+    EXPECT_EQ(0u, euc_kr.tags);
+    EXPECT_EQ(0u, latin1.latin1Fallbacks);
+    EXPECT_EQ(files, stats->total().files);
+#endif
+}
+
+// The totals of the test binary as JSON, to $SCAN_STATS_JSON or stdout.
+class ScanStatsEnvironment : public testing::Environment {
+public:
+    virtual void TearDown() {
+#if SCAN_STATS_ENABLED
+        const char* path = getenv("SCAN_STATS_JSON");
+        FILE* fp = path ? fopen(path, "w") : stdout;
+        if (fp == NULL) {
+            LOGE("can't write %s\n", path);
+            return;
+        }
+        ScanStats::dumpJson(fp, ScanStats::thread()->total());
+        fputc('\n', fp);
+        if (fp != stdout)
+            fclose(fp);
+#endif
+    }
+};
+
+static testing::Environment* const sScanStatsEnvironment =
+        testing::AddGlobalTestEnvironment(new ScanStatsEnvironment);
+
+// Counts what handleStringTag() allocates on its own.
+class AllocationCountingClient : public TestableMediaScannerClient {
+public:
+    AllocationCounter::Counts handled;
+
+    AllocationCountingClient() {
+        handled.allocations = 0;
+        handled.bytes = 0;
+    }
+
+    virtual status_t handleStringTag(const char* name, const char* value) {
+        AllocationCounter::Counts then = AllocationCounter::now();
+        status_t result = TestableMediaScannerClient::handleStringTag(name, value);
+        AllocationCounter::Counts spent = AllocationCounter::since(then);
+        handled.allocations += spent.allocations;
+        handled.bytes += spent.bytes;
+        return result;
+    }
+};
+
+struct allocation_report {
+    AllocationCounter::Counts added;    // in addStringTag()
+    AllocationCounter::Counts ended;    // in endFile()
+    AllocationCounter::Counts handled;  // in handleStringTag(), from either
+    int tags;
+    int files;
+};
+
+static void add_counts(AllocationCounter::Counts* to, const AllocationCounter::Counts& counts)
+{
+    to->allocations += counts.allocations;
+    to->bytes += counts.bytes;
+}
+
+// Scans the table as a file a few times to warm up, then counts the
+// allocations of scanning it files more times.
+static allocation_report __count_allocations(client_setup setup, str_pair* table,
+                                             unsigned int table_size, bool is_native,
+                                             const char* locale, int files)
+{
+    const int warm_up_files = 2;
+    allocation_report report;
+    memset(&report, 0, sizeof(report));
+
+    AllocationCountingClient client;
+    if (setup)
+        setup(&client);
+    if (locale)
+        client.setLocale(locale);
+
+    for (int f = 0; f < warm_up_files + files; f++) {
+        bool counted = f >= warm_up_files;
+        if (f == warm_up_files)
+            memset(&client.handled, 0, sizeof(client.handled));
+
+        client.beginFile();
+        for (unsigned int i = 0; i < table_size; i++) {
+            AllocationCounter::Counts then = AllocationCounter::now();
+            if (is_native)
+                client.addNativeStringTagWithIdx(i, table[i].native);
+            else
+                client.addStringTagWithIdx(i, table[i].native);
+            if (counted)
+                add_counts(&report.added, AllocationCounter::since(then));
+        }
+        AllocationCounter::Counts then = AllocationCounter::now();
+        client.endFile();
+        if (counted) {
+            add_counts(&report.ended, AllocationCounter::since(then));
+            report.tags += table_size;
+            report.files++;
+        }
+    }
+    report.handled = client.handled;
+    return report;
+}
+
+static void print_allocation_report(const char* path, const char* table, const char* locale,
+                                    const allocation_report& r)
+{
+    printf("allocations %-13s %-18s %-6s addStringTag %5.2f/tag %7.1f B/tag  "
+           "endFile %6.2f/file %8.1f B/file  handleStringTag %5.2f/tag %7.1f B/tag\n",
+           path, table, locale ? locale : "-",
+           (double)r.added.allocations / r.tags, (double)r.added.bytes / r.tags,
+           (double)r.ended.allocations / r.files, (double)r.ended.bytes / r.files,
+           (double)r.handled.allocations / r.tags, (double)r.handled.bytes / r.tags);
+}
+
+// allocations per tag a path may make once warm; $ALLOC_BUDGET_PER_TAG
+// overrides it.
+static double allocation_budget_per_tag()
+{
+    const char* env = getenv("ALLOC_BUDGET_PER_TAG");
+    return env ? atof(env) : 0;
+}
+
+// Reports every table under every locale for a path, and if gated, fails
+// the ones that allocate more per tag than the budget.
+static void test_allocations(const char* path, client_setup setup, bool gated)
+{
+    static const char* locales[] = { NULL, "ko", "ja", "zh", "zh_CN" };
+    const int files = 10;
+    double budget = allocation_budget_per_tag();
+
+#define __test_allocations_for(t, n) \
+    do { \
+        allocation_report r = __count_allocations(setup, t, sizeof(t)/sizeof(str_pair), \
+                                                  n, locales[l], files); \
+        print_allocation_report(path, #t, locales[l], r); \
+        if (gated) { \
+            EXPECT_LE((double)(r.added.allocations + r.ended.allocations) / r.tags, budget) \
+                << path << " " << #t << " " << (locales[l] ? locales[l] : "-"); \
+        } \
+    } while (0)
+
+    for (unsigned int l = 0; l < sizeof(locales)/sizeof(locales[0]); l++) {
+        __test_allocations_for(strs_utf_8, false);
+        __test_allocations_for(strs_windows_1252, true);
+        __test_allocations_for(strs_EUC_KR, true);
+        __test_allocations_for(strs_SHIFT_JIS, true);
+        __test_allocations_for(strs_GB2312, true);
+        __test_allocations_for(strs_Big5, true);
+    }
+
+#undef __test_allocations_for
+}
+
+// What MediaScannerClient allocates itself mostly goes by malloc() in
+// libmedia, which isn't counted, so it is only reported.
+TEST(AllocationTest, MediaScannerClient)
+{
+    test_allocations("libmedia", NULL, false);
+    test_allocations("prescreen", enable_prescreen, false);
+}
+
+// The TagConverter path must not allocate per tag once warm.
+TEST(AllocationTest, TagConverter_within_budget)
+{
+    ASSERT_TRUE(AllocationCounter::isIcuCounted());
+    test_allocations("TagConverter", enable_tag_converter, true);
+    test_allocations("TagView", enable_tag_view, true);
+}
+
+// Files made from the testee.h pairs with a seed: values chopped at
+// random points, tables of every encoding interleaved within a file,
+// under any locale, from a few tags to thousands. Each slice has a seed
+// of its own and its $STRESS_FILES files (200) are scanned by
+// MediaScannerClient and by every TagConverter path, which must agree;
+// $STRESS_SEED (1) changes the seeds. A mismatch names the seed and the
+// file, which is enough to make it again.
+struct stress_file {
+    const char* locale;
+    std::vector<std::string> values;
+    std::vector<bool> is_native;
+};
+
+static unsigned int stress_env(const char* name, unsigned int fallback)
+{
+    const char* env = getenv(name);
+    return env ? strtoul(env, NULL, 0) : fallback;
+}
+
+static void make_stress_file(stress_file* f)
+{
+    static const char* locales[] = { NULL, "ko", "ja", "zh", "zh_CN" };
+    f->locale = locales[rand() % 5];
+    f->values.clear();
+    f->is_native.clear();
+
+    // mostly a few tags, sometimes hundreds, now and then thousands.
+    int r = rand() % 100;
+    int tag_count = r < 80 ? 1 + rand() % 16 : r < 98 ? 1 + rand() % 500 : 1000 + rand() % 4000;
+    // mostly one or two tables, sometimes any.
+    unsigned int tables[2] = { rand() % enc_table_count, rand() % enc_table_count };
+    bool is_mixed = rand() % 8 == 0;
+
+    for (int i = 0; i < tag_count; i++) {
+        const enc_table& t = enc_tables[is_mixed ? rand() % enc_table_count : tables[rand() % 2]];
+        std::string value = t.table[rand() % t.size].native;
+        if (rand() % 4 == 0 && value.size() > 1)
+            value.resize(1 + rand() % (value.size() - 1));
+        f->values.push_back(value);
+        f->is_native.push_back(!is_utf8_encoding(t.encoding));
+    }
+}
+
+static void scan_stress_file(TestableMediaScannerClient* client, const stress_file& f)
+{
+    if (f.locale)
+        client->setLocale(f.locale);
+    client->beginFile();
+    for (size_t i = 0; i < f.values.size(); i++) {
+        if (f.is_native[i])
+            client->addNativeStringTagWithIdx(i, f.values[i].c_str());
+        else
+            client->addStringTagWithIdx(i, f.values[i].c_str());
+    }
+    client->endFile();
+}
+
+static std::string hex(const std::string& bytes)
+{
+    std::string out;
+    char byte[4];
+    for (size_t i = 0; i < bytes.size(); i++) {
+        snprintf(byte, sizeof(byte), "%02X ", (unsigned char)bytes[i]);
+        out += byte;
+    }
+    return out;
+}
+
+class StressTest : public testing::TestWithParam<int> {
+public:
+    enum { kSlices = 8 };
+};
+
+TEST_P(StressTest, same_results_as_MediaScannerClient)
+{
+    static const client_setup setups[] = {
+        enable_tag_converter, enable_tag_view, enable_lazy_conversion,
+        enable_tag_converter_with_cache, enable_prescreen,
+    };
+    const unsigned int setup_count = sizeof(setups)/sizeof(setups[0]);
+    unsigned int seed = stress_env("STRESS_SEED", 1) * kSlices + GetParam();
+    unsigned int files = stress_env("STRESS_FILES", 200);
+
+    srand(seed);
+    stress_file f;
+    size_t tags = 0;
+    bool failed = false;
+    for (unsigned int n = 0; n < files && !failed; n++) {
+        make_stress_file(&f);
+        tags += f.values.size();
+
+        // new clients for every file: a file without a locale needs a
+        // client that has never had one, as setLocale() keeps the last
+        // locale that detects.
+        TestableMediaScannerClient clients[2];
+        setups[n % setup_count](&clients[1]);
+        for (int i = 0; i < 2; i++)
+            scan_stress_file(&clients[i], f);
+
+        EXPECT_EQ(clients[0].getResultCount(), clients[1].getResultCount());
+        for (size_t i = 0; i < f.values.size() && !failed; i++) {
+            const char* expected = clients[0].getResult(i);
+            const char* result = clients[1].getResult(i);
+            failed = !expected || !result || strcmp(expected, result);
+            EXPECT_FALSE(failed)
+                << "seed " << seed << " file " << n << " setup " << n % setup_count
+                << " locale " << (f.locale ? f.locale : "-") << " tag " << i << ": "
+                << hex(f.values[i]) << "gave " << (result ? result : "NULL")
+                << " for " << (expected ? expected : "NULL");
+        }
+    }
+    printf("stress seed %u: %u files, %u tags\n", seed, files, (unsigned int)tags);
+}
+
+INSTANTIATE_TEST_SUITE_P(seeds, StressTest, testing::Range(0, (int)StressTest::kSlices));
+
+// Whole native strings of table back to back, as many as fit in
+// value_length bytes, so detection still passes the value.
+static std::string native_value(const str_pair* table, unsigned int size, size_t value_length)
+{
+    std::string value;
+    for (unsigned int i = 0, misses = 0; misses < size; i++) {
+        const char* native = table[i % size].native;
+        if (value.size() + strlen(native) > value_length) {
+            misses++;
+        } else {
+            value += native;
+            misses = 0;
+        }
+    }
+    return value;
+}
+
+static void scan_same_value(TestableMediaScannerClient* client, const std::string& value,
+                            int tag_count)
+{
+    client->beginFile();
+    for (int i = 0; i < tag_count; i++)
+        client->addNativeStringTagWithIdx(i, value.c_str());
+    client->endFile();
+}
+
+// File sizes from the smallest to one 256 times as large: 16 to 4096 tags
+// of 32 bytes, and 16 tags of 32 to 8192 bytes.
+static const int kLinearityTagCounts[] = { 16, 256, 4096 };
+static const size_t kLinearityValueLengths[] = { 32, 512, 8192 };
+static const unsigned int kLinearitySizes =
+        sizeof(kLinearityTagCounts)/sizeof(kLinearityTagCounts[0]);
+
+// Bytes allocated and, with SCAN_STATS, bytes given to ICU by the first
+// file of a new client, per byte of the file. Allocations are counted
+// in this binary, so it's the TagConverter paths only. Their arena and
+// vectors grow geometrically, so the bytes per byte must not go up with
+// the size of a file by more than kLimit; copying or reallocating all
+// of a file per tag does. The converters are opened first, so their
+// allocations don't count.
+static void test_work_linearity(const char* path, client_setup setup)
+{
+    const double kLimit = 4;
+    const unsigned int table_size = sizeof(strs_EUC_KR)/sizeof(str_pair);
+    double allocated[2][kLinearitySizes];
+
+    {
+        TestableMediaScannerClient client;
+        setup(&client);
+        client.setLocale("ko");
+        scan_same_value(&client, native_value(strs_EUC_KR, table_size, 32), 16);
+    }
+    for (int by_length = 0; by_length < 2; by_length++) {
+        for (unsigned int i = 0; i < kLinearitySizes; i++) {
+            int tag_count = by_length ? 16 : kLinearityTagCounts[i];
+            std::string value = native_value(strs_EUC_KR, table_size,
+                                             by_length ? kLinearityValueLengths[i] : 32);
+            double bytes = (double)tag_count * value.size();
+
+            TestableMediaScannerClient client;
+            setup(&client);
+            client.setLocale("ko");
+#if SCAN_STATS_ENABLED
+            ScanStats::thread()->clear();
+#endif
+            AllocationCounter::Counts then = AllocationCounter::now();
+            scan_same_value(&client, value, tag_count);
+            allocated[by_length][i] = AllocationCounter::since(then).bytes / bytes;
+#if SCAN_STATS_ENABLED
+            EXPECT_EQ((uint64_t)bytes, ScanStats::thread()->total().bytesConverted) << path;
+#endif
+            for (int k = 0; k < tag_count; k++)
+                ASSERT_STREQ(client.getResult(0), client.getResult(k));
+        }
+        printf("work %-13s %s: %.2f/%.2f/%.2f bytes allocated per byte\n", path,
+               by_length ? "by value length" : "by tag count   ",
+               allocated[by_length][0], allocated[by_length][1], allocated[by_length][2]);
+        for (unsigned int i = 1; i < kLinearitySizes; i++)
+            EXPECT_LE(allocated[by_length][i], allocated[by_length][0] * kLimit)
+                << path << (by_length ? " by value length " : " by tag count ") << i;
+    }
+}
+
+TEST(LinearityTest, TagConverter_work)
+{
+    test_work_linearity("TagConverter", enable_tag_converter);
+    test_work_linearity("TagView", enable_tag_view);
+}
+
+// Best of a few runs of count files of tag_count values of value, in ns
+// per byte.
+static double ns_per_byte(client_setup setup, const std::string& value, const char* locale,
+                          int tag_count, int count)
+{
+    TestableMediaScannerClient client;
+    if (setup)
+        setup(&client);
+    client.setLocale(locale);
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int n = 0; n < count; n++)
+            scan_same_value(&client, value, tag_count);
+        double ns = (double)(systemTime(SYSTEM_TIME_MONOTONIC) - start) /
+                    ((double)count * tag_count * value.size());
+        if (run == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+// ns per byte may grow by at most $LINEARITY_LIMIT (16) times from the
+// smallest file to one 256 times as large, in tags or in value length;
+// anything quadratic in addStringTag() or endFile() goes far past that.
+// The work is the same at every size. It's wall clock time, so the
+// limit leaves room for a busy device; set it to 4 on a quiet one.
+static void test_linearity(const char* path, client_setup setup)
+{
+    const char* env = getenv("LINEARITY_LIMIT");
+    const double limit = env ? atof(env) : 16;
+    const size_t total = 1 << 20;
+    const unsigned int table_size = sizeof(strs_EUC_KR)/sizeof(str_pair);
+    std::string short_value = native_value(strs_EUC_KR, table_size, 32);
+    double tags[kLinearitySizes], lengths[kLinearitySizes];
+
+    for (unsigned int i = 0; i < kLinearitySizes; i++) {
+        std::string value = native_value(strs_EUC_KR, table_size, kLinearityValueLengths[i]);
+        tags[i] = ns_per_byte(setup, short_value, "ko", kLinearityTagCounts[i],
+                              total / (kLinearityTagCounts[i] * short_value.size()));
+        lengths[i] = ns_per_byte(setup, value, "ko", 16, total / (16 * value.size()));
+    }
+    printf("linearity %-13s tags %d/%d/%d: %.2f/%.2f/%.2f ns/byte  "
+           "value bytes %d/%d/%d: %.2f/%.2f/%.2f ns/byte\n", path,
+           kLinearityTagCounts[0], kLinearityTagCounts[1], kLinearityTagCounts[2],
+           tags[0], tags[1], tags[2],
+           (int)kLinearityValueLengths[0], (int)kLinearityValueLengths[1],
+           (int)kLinearityValueLengths[2], lengths[0], lengths[1], lengths[2]);
+    EXPECT_LE(tags[kLinearitySizes - 1], tags[0] * limit) << path << " by tag count";
+    EXPECT_LE(lengths[kLinearitySizes - 1], lengths[0] * limit) << path << " by value length";
+}
+
+TEST(LinearityTest, MediaScannerClient)
+{
+    test_linearity("libmedia", NULL);
+}
+
+TEST(LinearityTest, TagConverter)
+{
+    test_linearity("TagConverter", enable_tag_converter);
+    test_linearity("TagView", enable_tag_view);
+}
+
 }
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "NativeEncodingDetector.h"
+
+namespace android {
+
+// Each byte's class holds four 4-bit fields, one bit per NativeEncoding
+// in each, and a flag for ASCII letters.
+#define LEAD(e)     ((uint32_t)(e))         // starts a double byte char
+#define TRAIL(e)    ((uint32_t)(e) << 4)    // may end one
+#define SINGLE(e)   ((uint32_t)(e) << 8)    // high byte that stands alone
+#define RARE(e)     ((uint32_t)(e) << 12)   // lead of a rarely used plane
+#define LETTER      ((uint32_t)1 << 16)
+
+struct ByteRange {
+    uint32_t bits;
+    uint8_t first;
+    uint8_t last;
+};
+
+// GBK is checked as its GB2312 planes and Big5 as its symbols and
+// frequently used characters, where tag text lives. The GBK extensions
+// and the rarely used Big5 plane would let through most Latin-1 text
+// and, for Big5, about any EUC-KR or GB2312 text.
+static const ByteRange kByteRanges[] = {
+    { LEAD(kNativeEncodingShiftJIS),    0x81, 0x9F },
+    { LEAD(kNativeEncodingShiftJIS),    0xE0, 0xEF },
+    { RARE(kNativeEncodingShiftJIS),    0xE0, 0xEF },
+    { TRAIL(kNativeEncodingShiftJIS),   0x40, 0x7E },
+    { TRAIL(kNativeEncodingShiftJIS),   0x80, 0xFC },
+    { SINGLE(kNativeEncodingShiftJIS),  0xA1, 0xDF },   // half width katakana
+
+    // rows 0xAA to 0xAF are unassigned in GB2312.
+    { LEAD(kNativeEncodingGBK),         0xA1, 0xA9 },
+    { LEAD(kNativeEncodingGBK),         0xB0, 0xF7 },
+    { TRAIL(kNativeEncodingGBK),        0xA1, 0xFE },
+
+    { LEAD(kNativeEncodingBig5),        0xA1, 0xC6 },
+    { TRAIL(kNativeEncodingBig5),       0x40, 0x7E },
+    { TRAIL(kNativeEncodingBig5),       0xA1, 0xFE },
+
+    { LEAD(kNativeEncodingEUCKR),       0xA1, 0xFE },
+    { TRAIL(kNativeEncodingEUCKR),      0xA1, 0xFE },
+
+    { LETTER,                           'A',  'Z'  },
+    { LETTER,                           'a',  'z'  },
+};
+
+static uint32_t sByteClass[256];
+static pthread_once_t sByteClassOnce = PTHREAD_ONCE_INIT;
+
+static void initByteClass()
+{
+    memset(sByteClass, 0, sizeof(sByteClass));
+    for (size_t i = 0; i < sizeof(kByteRanges)/sizeof(kByteRanges[0]); i++) {
+        for (int b = kByteRanges[i].first; b <= kByteRanges[i].last; b++)
+            sByteClass[b] |= kByteRanges[i].bits;
+    }
+}
+
+NativeEncoding localeNativeEncoding(const char* locale)
+{
+    if (!locale)
+        return kNativeEncodingNone;
+    if (!strncmp(locale, "ja", 2))
+        return kNativeEncodingShiftJIS;
+    if (!strncmp(locale, "ko", 2))
+        return kNativeEncodingEUCKR;
+    if (!strncmp(locale, "zh", 2)) {
+        // simplified chinese for mainland China, traditional elsewhere
+        if (!strcmp(locale, "zh_CN"))
+            return kNativeEncodingGBK;
+        return kNativeEncodingBig5;
+    }
+    return kNativeEncodingNone;
+}
+
+const char* nativeEncodingCharset(NativeEncoding encoding)
+{
+    switch (encoding) {
+        case kNativeEncodingShiftJIS:
+            return "shift-jis";
+        case kNativeEncodingGBK:
+            return "gbk";
+        case kNativeEncodingBig5:
+            return "Big5";
+        case kNativeEncodingEUCKR:
+            return "EUC-KR";
+        default:
+            return NULL;
+    }
+}
+
+struct ScanState {
+    uint32_t alive;
+    uint32_t waiting;           // encodings expecting a trail byte
+    uint32_t rare;              // ... of a rare lead that followed a letter
+    bool prevLetter;
+};
+
+static inline void startValue(ScanState* s)
+{
+    s->waiting = 0;
+    s->rare = 0;
+    s->prevLetter = false;
+}
+
+static inline void scanBytes(const uint8_t* p, size_t len, ScanState* s)
+{
+    uint32_t alive = s->alive;
+    uint32_t waiting = s->waiting;
+    uint32_t rare = s->rare;
+    bool prevLetter = s->prevLetter;
+
+    for (size_t i = 0; i < len && alive; i++) {
+        uint8_t b = p[i];
+        uint32_t c = sByteClass[b];
+        bool letter = (c & LETTER) != 0;
+
+        if (waiting) {
+            alive &= ~(waiting & ~((c >> 4) & 0xF));
+            if (letter)
+                alive &= ~rare;
+        }
+
+        uint32_t starting = alive & ~waiting;
+        if (b & 0x80) {
+            uint32_t lead = c & 0xF;
+            uint32_t single = (c >> 8) & 0xF;
+            alive &= ~(starting & ~(lead | single));
+            waiting = starting & lead & alive;
+            rare = prevLetter ? (waiting & (c >> 12) & 0xF) : 0;
+        } else {
+            waiting = 0;
+            rare = 0;
+        }
+        prevLetter = letter;
+    }
+
+    s->alive = alive;
+    s->waiting = waiting;
+    s->rare = rare;
+    s->prevLetter = prevLetter;
+}
+
+NativeEncodingScan scanNativeEncodings(const char* bytes, size_t len, uint32_t candidates)
+{
+    pthread_once(&sByteClassOnce, initByteClass);
+
+    ScanState s;
+    s.alive = candidates & kNativeEncodingAll;
+    startValue(&s);
+    scanBytes((const uint8_t*)bytes, len, &s);
+
+    NativeEncodingScan scan;
+    scan.possible = s.alive;
+    scan.truncated = s.waiting & s.alive;
+    return scan;
+}
+
+// Encodings ruled out by one value are out for all of them, so a single
+// alive set runs through the values; only the trail state restarts.
+uint32_t scanNativeEncodingValues(const char* bytes, const size_t* lengths, size_t count,
+                                  uint32_t* truncated, uint32_t candidates)
+{
+    pthread_once(&sByteClassOnce, initByteClass);
+
+    const uint8_t* p = (const uint8_t*)bytes;
+    ScanState s;
+    s.alive = candidates & kNativeEncodingAll;
+    for (size_t i = 0; i < count; i++) {
+        startValue(&s);
+        scanBytes(p, lengths[i], &s);
+        truncated[i] = s.waiting & s.alive;
+        p += lengths[i] + 1;
+    }
+    return s.alive;
+}
+
+}
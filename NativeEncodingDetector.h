@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_ENCODING_DETECTOR_H
+#define NATIVE_ENCODING_DETECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Candidate native encodings, one bit each, in the order of
+// MediaScannerClient's locale encodings.
+enum NativeEncoding {
+    kNativeEncodingNone     = 0,
+    kNativeEncodingShiftJIS = 1 << 0,
+    kNativeEncodingGBK      = 1 << 1,
+    kNativeEncodingBig5     = 1 << 2,
+    kNativeEncodingEUCKR    = 1 << 3,
+    kNativeEncodingAll      = 0xF,
+};
+
+// The encoding MediaScannerClient::setLocale() picks for locale.
+NativeEncoding localeNativeEncoding(const char* locale);
+
+// ICU charset name of a single encoding, NULL for none.
+const char* nativeEncodingCharset(NativeEncoding encoding);
+
+// Result of checking some bytes against every candidate at once.
+struct NativeEncodingScan {
+    // encodings the bytes are well formed in.
+    uint32_t possible;
+    // encodings of possible in which the last byte is an unfinished lead
+    // byte, as left by tags chopped in the middle of a character.
+    uint32_t truncated;
+};
+
+// Walks bytes once and runs a small state machine per candidate encoding
+// in parallel, driven by one 256 entry table of lead/trail byte classes.
+//
+// Besides the byte ranges, one heuristic keeps Latin-1 words from
+// passing as Shift-JIS: a JIS level 2 kanji whose lead follows and whose
+// trail is an ASCII letter, like "J\xE1s" in "J\xE1szber\xE9nyi", rules
+// the encoding out.
+//
+// Only the encodings of candidates are checked, and the walk stops as
+// soon as none of them is left.
+NativeEncodingScan scanNativeEncodings(const char* bytes, size_t len,
+                                       uint32_t candidates = kNativeEncodingAll);
+
+// The scan of count values laid back to back in bytes, each followed by a
+// zero, in one pass. Returns the encodings every value is well formed in
+// and sets truncated[i] to the truncated encodings of value i among them.
+uint32_t scanNativeEncodingValues(const char* bytes, const size_t* lengths, size_t count,
+                                  uint32_t* truncated,
+                                  uint32_t candidates = kNativeEncodingAll);
+
+}
+
+#endif // NATIVE_ENCODING_DETECTOR_H
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ScanDriver"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include "ScanDriver.h"
+#include "TestableMediaScannerClient.h"
+
+namespace android {
+
+ScanDriver::ScanDriver(const char* locale, ClientSetup setup)
+    : _locale(locale),
+      _setup(setup),
+      _files(NULL),
+      _digests(NULL)
+{
+}
+
+uint64_t ScanDriver::digest(const char* const* values, int valueCount)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < valueCount; i++) {
+        // the terminating zero separates the values.
+        const unsigned char* p = (const unsigned char*)values[i];
+        do {
+            h ^= *p;
+            h *= 1099511628211ULL;
+        } while (*p++);
+    }
+    return h;
+}
+
+status_t ScanDriver::run(const std::vector<File>& files, int threadCount, Result* result)
+{
+    if (threadCount < 1)
+        return BAD_VALUE;
+
+    result->digests.assign(files.size(), 0);
+    result->fileCount = files.size();
+    result->tagCount = 0;
+    result->steals = 0;
+    result->counters.clear();
+    _files = &files;
+    _digests = &result->digests;
+
+    _shares.resize(threadCount);
+    for (int i = 0; i < threadCount; i++) {
+        pthread_mutex_init(&_shares[i].lock, NULL);
+        _shares[i].begin = files.size() * i / threadCount;
+        _shares[i].end = files.size() * (i + 1) / threadCount;
+    }
+
+    std::vector<Worker> workers(threadCount);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    int started = 0;
+    status_t status = OK;
+    for (int i = 0; i < threadCount; i++) {
+        Worker& w = workers[i];
+        w.driver = this;
+        w.id = i;
+        w.tagCount = 0;
+        w.steals = 0;
+        w.status = OK;
+        w.counters.clear();
+        if (pthread_create(&w.thread, NULL, workerMain, &w) != 0) {
+            LOGE("pthread_create failed for worker %d\n", i);
+            // the started workers steal this one's share.
+            status = UNKNOWN_ERROR;
+            break;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        result->tagCount += workers[i].tagCount;
+        result->steals += workers[i].steals;
+        result->counters.add(workers[i].counters);
+        if (workers[i].status != OK)
+            status = workers[i].status;
+    }
+    result->elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    for (int i = 0; i < threadCount; i++)
+        pthread_mutex_destroy(&_shares[i].lock);
+    _shares.clear();
+    _files = NULL;
+    _digests = NULL;
+
+    return status;
+}
+
+void* ScanDriver::workerMain(void* arg)
+{
+    Worker* w = static_cast<Worker*>(arg);
+    ScanDriver* driver = w->driver;
+
+    TestableMediaScannerClient* client = new TestableMediaScannerClient();
+    client->setLocale(driver->_locale);
+    if (driver->_setup)
+        driver->_setup(client);
+
+    size_t file;
+    for (;;) {
+        if (!driver->take(w->id, &file)) {
+            if (!driver->steal(w->id))
+                break;
+            w->steals++;
+            continue;
+        }
+        status_t status = driver->scan(client, file, &w->tagCount);
+        if (status != OK)
+            w->status = status;
+    }
+
+    client->releaseResults();
+    delete client;
+#if SCAN_STATS_ENABLED
+    w->counters = ScanStats::thread()->total();
+    ScanStats::releaseThread();
+#endif
+    // converters are cached per thread; close this worker's now.
+    ConverterCache::releaseThreadCache();
+    return NULL;
+}
+
+bool ScanDriver::take(int id, size_t* file)
+{
+    Share& share = _shares[id];
+    pthread_mutex_lock(&share.lock);
+    bool taken = share.begin < share.end;
+    if (taken)
+        *file = share.begin++;
+    pthread_mutex_unlock(&share.lock);
+    return taken;
+}
+
+// Moves the back half of the largest other share to this worker's. As
+// no files are added once a run has started, finding every share empty
+// means the run is over.
+bool ScanDriver::steal(int id)
+{
+    for (;;) {
+        int victim = -1;
+        size_t largest = 0;
+        for (size_t i = 0; i < _shares.size(); i++) {
+            if ((int)i == id)
+                continue;
+            // sizes may change once unlocked; rechecked under the
+            // victim's lock below.
+            pthread_mutex_lock(&_shares[i].lock);
+            size_t begin = _shares[i].begin;
+            size_t end = _shares[i].end;
+            pthread_mutex_unlock(&_shares[i].lock);
+            if (end > begin && end - begin > largest) {
+                largest = end - begin;
+                victim = i;
+            }
+        }
+        if (victim < 0)
+            return false;
+
+        Share& from = _shares[victim];
+        pthread_mutex_lock(&from.lock);
+        if (from.begin >= from.end) {
+            pthread_mutex_unlock(&from.lock);
+            continue;
+        }
+        size_t mid = from.begin + (from.end - from.begin) / 2;
+        size_t end = from.end;
+        from.end = mid;
+        pthread_mutex_unlock(&from.lock);
+
+        // a share of one file leaves mid == begin: the thief takes it.
+        Share& to = _shares[id];
+        pthread_mutex_lock(&to.lock);
+        to.begin = mid;
+        to.end = end;
+        pthread_mutex_unlock(&to.lock);
+        return true;
+    }
+}
+
+status_t ScanDriver::scan(TestableMediaScannerClient* client, size_t file, size_t* tagCount)
+{
+    const File& f = (*_files)[file];
+
+    client->beginFile();
+    for (int i = 0; i < f.valueCount; i++) {
+        bool added = f.isNative ? client->addNativeStringTagWithIdx(i, f.values[i])
+                                : client->addStringTagWithIdx(i, f.values[i]);
+        if (!added) {
+            client->endFile();
+            return UNKNOWN_ERROR;
+        }
+    }
+    client->endFile();
+
+    int count = client->getResultCount();
+    const char* stackValues[32];
+    std::vector<const char*> heapValues;
+    const char** values = stackValues;
+    if (count > (int)(sizeof(stackValues) / sizeof(stackValues[0]))) {
+        heapValues.resize(count);
+        values = &heapValues[0];
+    }
+    for (int i = 0; i < count; i++) {
+        values[i] = client->getResult(i);
+        if (!values[i])
+            return NO_MEMORY;
+    }
+
+    (*_digests)[file] = digest(values, count);
+    *tagCount += count;
+    return OK;
+}
+
+}
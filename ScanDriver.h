@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCAN_DRIVER_H
+#define SCAN_DRIVER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+#include "ScanStats.h"
+
+namespace android {
+
+class TestableMediaScannerClient;
+
+// Scans a list of synthetic files on a pool of worker threads.
+//
+// Every worker has a TestableMediaScannerClient of its own and starts
+// with an even, contiguous share of the files. A worker that runs out
+// steals the back half of the largest share left, so a slow share
+// doesn't hold up the others. Each file's results are folded into a
+// digest at the file's index, which makes a run comparable with any
+// other run of the same files, whatever the number of threads.
+class ScanDriver {
+public:
+    // A file is a tag set. Values are given to addNativeStringTagWithIdx()
+    // if isNative, else to addStringTagWithIdx(), indexed in order.
+    struct File {
+        const char* const* values;
+        int valueCount;
+        bool isNative;
+    };
+
+    // Called once for each worker's client after its locale is set. It
+    // runs on the worker thread, so anything it hands to the client, such
+    // as a DetectionCache, must not be shared between workers.
+    typedef void (*ClientSetup)(TestableMediaScannerClient* client);
+
+    struct Result {
+        std::vector<uint64_t> digests;  // by file index
+        size_t fileCount;
+        size_t tagCount;
+        size_t steals;
+        nsecs_t elapsed;
+        ScanCounters counters;  // of every worker; zero without SCAN_STATS
+    };
+
+    ScanDriver(const char* locale, ClientSetup setup = NULL);
+
+    status_t run(const std::vector<File>& files, int threadCount, Result* result);
+
+    // digest of the results of a file; FNV-1a of the values in order,
+    // none of which may be NULL.
+    static uint64_t digest(const char* const* values, int valueCount);
+
+private:
+    // files [begin, end) not yet taken by a worker.
+    struct Share {
+        pthread_mutex_t lock;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Worker {
+        ScanDriver* driver;
+        int id;
+        pthread_t thread;
+        size_t tagCount;
+        size_t steals;
+        status_t status;
+        ScanCounters counters;
+    };
+
+    const char* _locale;
+    ClientSetup _setup;
+    const std::vector<File>* _files;
+    std::vector<Share> _shares;
+    std::vector<uint64_t>* _digests;
+
+    static void* workerMain(void* arg);
+    bool take(int id, size_t* file);
+    bool steal(int id);
+    status_t scan(TestableMediaScannerClient* client, size_t file, size_t* tagCount);
+
+    ScanDriver(const ScanDriver&);
+    ScanDriver& operator=(const ScanDriver&);
+};
+
+}
+
+#endif // SCAN_DRIVER_H
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ScanPipeline"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ScanPipeline.h"
+#include "TestableMediaScannerClient.h"
+
+namespace android {
+
+void ScanPipeline::Job::reset(size_t index)
+{
+    file = index;
+    status = OK;
+    frames.clear();
+    text.clear();
+    results.clear();
+    output.clear();
+}
+
+// Copies the frame, as the mapping of the file is gone by the time the
+// worker gets it. A zero follows each text, so that an empty one still
+// has an address.
+status_t ScanPipeline::Job::handleId3Text(const char* frameId, Id3TextEncoding encoding,
+                                          const char* data, size_t length)
+{
+    Frame frame;
+    strncpy(frame.frameId, frameId, sizeof(frame.frameId) - 1);
+    frame.frameId[sizeof(frame.frameId) - 1] = 0;
+    frame.encoding = encoding;
+    frame.offset = text.size();
+    frame.length = length;
+    frames.push_back(frame);
+    text.insert(text.end(), data, data + length);
+    text.push_back(0);
+    return OK;
+}
+
+ScanPipeline::ScanPipeline(MediaScannerClient* client, const char* locale,
+                           ScanDriver::ClientSetup setup)
+    : _client(client),
+      _locale(locale),
+      _setup(setup),
+      _digests(NULL),
+      _submitted(0),
+      _delivered(0),
+      _status(OK)
+{
+}
+
+ScanPipeline::~ScanPipeline()
+{
+    finish();
+}
+
+status_t ScanPipeline::start(int workerCount, int depth)
+{
+    if (workerCount < 1 || depth < 1)
+        return BAD_VALUE;
+    if (!_workers.empty())
+        return INVALID_OPERATION;
+
+    _submitted = 0;
+    _delivered = 0;
+    _status = OK;
+    for (int i = 0; i < workerCount * depth; i++) {
+        _jobs.push_back(new Job());
+        _free.push_back(_jobs.back());
+    }
+
+    _workers.resize(workerCount);
+    for (int i = 0; i < workerCount; i++) {
+        Worker& w = _workers[i];
+        w.pipeline = this;
+        w.input = new SpscQueue(depth);
+        w.output = new SpscQueue(depth);
+        if (pthread_create(&w.thread, NULL, workerMain, &w) != 0) {
+            LOGE("pthread_create failed for worker %d\n", i);
+            delete w.input;
+            delete w.output;
+            _workers.resize(i);
+            stop();
+            return UNKNOWN_ERROR;
+        }
+    }
+    return OK;
+}
+
+status_t ScanPipeline::scanFile(const char* path)
+{
+    if (_workers.empty())
+        return INVALID_OPERATION;
+
+    if (_free.empty())
+        deliverOldest();
+    Job* job = _free.back();
+    _free.pop_back();
+    job->reset(_submitted);
+
+    Id3Reader reader;
+    status_t result = reader.open(path);
+    if (result == OK)
+        result = reader.parse(job);
+    job->status = result;
+
+    // it can't be full: a worker has at most depth of the jobs.
+    SpscQueue* input = _workers[_submitted % _workers.size()].input;
+    for (int round = 0; !input->push(job); round++)
+        SpscQueue::wait(round);
+    _submitted++;
+    return result;
+}
+
+status_t ScanPipeline::finish()
+{
+    if (_workers.empty())
+        return OK;
+    while (_delivered < _submitted)
+        deliverOldest();
+    stop();
+    return _status;
+}
+
+void ScanPipeline::deliverOldest()
+{
+    SpscQueue* output = _workers[_delivered % _workers.size()].output;
+    void* item;
+    for (int round = 0; !output->pop(&item); round++)
+        SpscQueue::wait(round);
+    Job* job = static_cast<Job*>(item);
+    _delivered++;
+
+    status_t result = job->status;
+    if (result == OK) {
+        size_t count = job->results.size() / 2;
+        _values.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const char* name = &job->output[job->results[2 * i]];
+            _values[i] = &job->output[job->results[2 * i + 1]];
+            status_t delivered = _client->handleStringTag(name, _values[i]);
+            if (delivered != OK && result == OK)
+                result = delivered;
+        }
+        if (_digests) {
+            if (_digests->size() <= job->file)
+                _digests->resize(job->file + 1, 0);
+            (*_digests)[job->file] = ScanDriver::digest(count ? &_values[0] : NULL, count);
+        }
+    }
+    if (result != OK && _status == OK)
+        _status = result;
+    _free.push_back(job);
+}
+
+void ScanPipeline::stop()
+{
+    for (size_t i = 0; i < _workers.size(); i++) {
+        for (int round = 0; !_workers[i].input->push(NULL); round++)
+            SpscQueue::wait(round);
+    }
+    for (size_t i = 0; i < _workers.size(); i++) {
+        pthread_join(_workers[i].thread, NULL);
+        delete _workers[i].input;
+        delete _workers[i].output;
+    }
+    _workers.clear();
+
+    for (size_t i = 0; i < _jobs.size(); i++)
+        delete _jobs[i];
+    _jobs.clear();
+    _free.clear();
+}
+
+void* ScanPipeline::workerMain(void* arg)
+{
+    Worker* w = static_cast<Worker*>(arg);
+    ScanPipeline* pipeline = w->pipeline;
+
+    TestableMediaScannerClient* client = new TestableMediaScannerClient();
+    client->setLocale(pipeline->_locale);
+    if (pipeline->_setup)
+        pipeline->_setup(client);
+
+    for (;;) {
+        void* item;
+        for (int round = 0; !w->input->pop(&item); round++)
+            SpscQueue::wait(round);
+        // NULL is stop().
+        if (!item)
+            break;
+        Job* job = static_cast<Job*>(item);
+        if (job->status == OK)
+            convert(client, job);
+        // it can't be full either.
+        for (int round = 0; !w->output->push(job); round++)
+            SpscQueue::wait(round);
+    }
+
+    client->releaseResults();
+    delete client;
+#if SCAN_STATS_ENABLED
+    ScanStats::releaseThread();
+#endif
+    // converters are cached per thread; close this worker's now.
+    ConverterCache::releaseThreadCache();
+    return NULL;
+}
+
+// As TestableMediaScannerClient::scanFile() from the copied frames, with
+// the results, named as the client has them, copied into the job.
+void ScanPipeline::convert(TestableMediaScannerClient* client, Job* job)
+{
+    client->beginFile();
+    for (size_t i = 0; i < job->frames.size(); i++) {
+        const Job::Frame& f = job->frames[i];
+        status_t result = client->handleId3Text(f.frameId, f.encoding, &job->text[f.offset],
+                                                f.length);
+        if (result != OK) {
+            job->status = result;
+            break;
+        }
+    }
+    client->endFile();
+    if (job->status != OK)
+        return;
+
+    int count = client->getResultCount();
+    for (int i = 0; i < count; i++) {
+        char index[16];
+        int32_t id = client->getResultId(i);
+        const char* name = client->getTagName(id);
+        if (!name) {
+            snprintf(index, sizeof(index), "%d", id);
+            name = index;
+        }
+        const char* value = client->getResult(i);
+        if (!value) {
+            job->status = NO_MEMORY;
+            return;
+        }
+        job->results.push_back(job->output.size());
+        job->output.insert(job->output.end(), name, name + strlen(name) + 1);
+        job->results.push_back(job->output.size());
+        job->output.insert(job->output.end(), value, value + strlen(value) + 1);
+    }
+}
+
+}
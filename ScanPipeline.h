@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCAN_PIPELINE_H
+#define SCAN_PIPELINE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <media/mediascanner.h>
+
+#include "Id3Reader.h"
+#include "ScanDriver.h"
+#include "SpscQueue.h"
+
+namespace android {
+
+class TestableMediaScannerClient;
+
+// Scans files in two stages, so reading tags and converting them overlap.
+//
+// scanFile() reads a file's ID3 text frames on the calling thread and
+// copies them into a job, which goes to a conversion worker through a
+// SpscQueue. The worker runs the frames through a
+// TestableMediaScannerClient of its own, beginFile() to endFile(), and
+// sends the job back through another SpscQueue with the converted tags.
+// Files are dealt to the workers in turn and collected in the same turn,
+// so the caller gets the results in the order it gave the files.
+//
+// There are depth jobs per worker. When all of them are out, scanFile()
+// first waits for the oldest to come back: that is the backpressure that
+// keeps the reading stage at most depth files ahead of each worker.
+// Results are delivered on the calling thread, by scanFile() and
+// finish(), to client->handleStringTag().
+class ScanPipeline {
+public:
+    // setup is called on each worker's client, on the worker thread, after
+    // its locale is set; see ScanDriver::ClientSetup.
+    ScanPipeline(MediaScannerClient* client, const char* locale,
+                 ScanDriver::ClientSetup setup = NULL);
+    // finish()es.
+    ~ScanPipeline();
+
+    // Starts workerCount conversion threads.
+    status_t start(int workerCount, int depth);
+
+    // Reads the tags of the file at path and queues them for conversion,
+    // after delivering the oldest file if every job is out. Fails if the
+    // file can't be read; its index is used up all the same.
+    status_t scanFile(const char* path);
+
+    // Delivers the files still out and stops the workers. Returns the
+    // first error since start() of reading, converting or delivering a
+    // file.
+    status_t finish();
+
+    // Folds each file's results into ScanDriver::digest() at its index,
+    // as they are delivered. NULL, the default, doesn't.
+    void setDigests(std::vector<uint64_t>* digests) { _digests = digests; }
+
+private:
+    struct Job : public Id3TextHandler {
+        struct Frame {
+            char frameId[5];
+            Id3TextEncoding encoding;
+            size_t offset;      // into text
+            size_t length;
+        };
+
+        size_t file;
+        status_t status;
+        std::vector<Frame> frames;
+        std::vector<char> text;
+        // name and value offsets into output, in result order
+        std::vector<size_t> results;
+        std::vector<char> output;
+
+        void reset(size_t index);
+        virtual status_t handleId3Text(const char* frameId, Id3TextEncoding encoding,
+                                       const char* text, size_t length);
+    };
+
+    struct Worker {
+        ScanPipeline* pipeline;
+        pthread_t thread;
+        SpscQueue* input;
+        SpscQueue* output;
+    };
+
+    MediaScannerClient* _client;
+    const char* _locale;
+    ScanDriver::ClientSetup _setup;
+    std::vector<uint64_t>* _digests;
+    std::vector<Worker> _workers;
+    std::vector<Job*> _jobs;
+    std::vector<Job*> _free;
+    std::vector<const char*> _values;   // of the file being delivered
+    size_t _submitted;
+    size_t _delivered;
+    status_t _status;
+
+    static void* workerMain(void* arg);
+    static void convert(TestableMediaScannerClient* client, Job* job);
+    void deliverOldest();
+    void stop();
+
+    ScanPipeline(const ScanPipeline&);
+    ScanPipeline& operator=(const ScanPipeline&);
+};
+
+}
+
+#endif // SCAN_PIPELINE_H
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ScanStats"
+#include <utils/Log.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#include "ScanStats.h"
+
+namespace android {
+
+static pthread_key_t sStatsKey;
+static pthread_once_t sStatsKeyOnce = PTHREAD_ONCE_INIT;
+
+void ScanCounters::clear()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+void ScanCounters::add(const ScanCounters& other)
+{
+    files += other.files;
+    tags += other.tags;
+    detectedTags += other.detectedTags;
+    candidateEncodings += other.candidateEncodings;
+    converterOpens += other.converterOpens;
+    latin1Fallbacks += other.latin1Fallbacks;
+    bytesConverted += other.bytesConverted;
+    addStringTagNs += other.addStringTagNs;
+    endFileNs += other.endFileNs;
+    handleStringTagNs += other.handleStringTagNs;
+}
+
+ScanStats::ScanStats()
+{
+    clear();
+}
+
+void ScanStats::createKey()
+{
+    pthread_key_create(&sStatsKey, destroyThread);
+}
+
+void ScanStats::destroyThread(void* stats)
+{
+    delete static_cast<ScanStats*>(stats);
+}
+
+ScanStats* ScanStats::thread()
+{
+    pthread_once(&sStatsKeyOnce, createKey);
+    ScanStats* stats = static_cast<ScanStats*>(pthread_getspecific(sStatsKey));
+    if (stats == NULL) {
+        stats = new ScanStats();
+        pthread_setspecific(sStatsKey, stats);
+    }
+    return stats;
+}
+
+void ScanStats::releaseThread()
+{
+    pthread_once(&sStatsKeyOnce, createKey);
+    ScanStats* stats = static_cast<ScanStats*>(pthread_getspecific(sStatsKey));
+    pthread_setspecific(sStatsKey, NULL);
+    delete stats;
+}
+
+ScanCounters ScanStats::total() const
+{
+    ScanCounters total = _total;
+    total.add(_file);
+    return total;
+}
+
+// counts made between files go to the next one.
+void ScanStats::beginFile()
+{
+    if (_file.files) {
+        _total.add(_file);
+        _file.clear();
+    }
+}
+
+void ScanStats::clear()
+{
+    _file.clear();
+    _total.clear();
+}
+
+void ScanStats::dumpJson(FILE* fp, const ScanCounters& c)
+{
+    fprintf(fp, "{\"files\": %u, \"tags\": %u, \"detectedTags\": %u, "
+                "\"candidateEncodings\": %u, \"converterOpens\": %u, "
+                "\"latin1Fallbacks\": %u, \"bytesConverted\": %llu, "
+                "\"addStringTagNs\": %llu, \"endFileNs\": %llu, "
+                "\"handleStringTagNs\": %llu}",
+            c.files, c.tags, c.detectedTags, c.candidateEncodings, c.converterOpens,
+            c.latin1Fallbacks, (unsigned long long)c.bytesConverted,
+            (unsigned long long)c.addStringTagNs, (unsigned long long)c.endFileNs,
+            (unsigned long long)c.handleStringTagNs);
+}
+
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCAN_STATS_H
+#define SCAN_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <utils/Timers.h>
+
+// Build with SCAN_STATS_ENABLED=1 (SCAN_STATS=true in Android.mk) to
+// count. Otherwise every SCAN_STATS_* macro is empty, and the counters
+// read back zero.
+#ifndef SCAN_STATS_ENABLED
+#define SCAN_STATS_ENABLED 0
+#endif
+
+namespace android {
+
+// What the scan of a file, or of every file so far, was spent on.
+// addStringTagNs and endFileNs include the handleStringTag() calls made
+// from them.
+struct ScanCounters {
+    uint32_t files;
+    uint32_t tags;                  // given to addStringTag()
+    uint32_t detectedTags;          // scanned for their native encoding
+    uint32_t candidateEncodings;    // left possible by those scans
+    uint32_t converterOpens;        // ucnv_open() by ConverterCache
+    uint32_t latin1Fallbacks;       // detected, then kept as Latin-1
+    uint64_t bytesConverted;        // native bytes given to ICU
+    uint64_t addStringTagNs;
+    uint64_t endFileNs;
+    uint64_t handleStringTagNs;
+
+    void clear();
+    void add(const ScanCounters& other);
+};
+
+// Counters of the calling thread, so the workers of a ScanDriver count
+// their own files without locking.
+class ScanStats {
+public:
+    static ScanStats* thread();
+    static void releaseThread();
+
+    // Since the last beginFile().
+    const ScanCounters& file() const { return _file; }
+    // Since the thread started counting, or the last clear().
+    ScanCounters total() const;
+
+    void beginFile();
+    void endFile() { _file.files = 1; }
+    void clear();
+
+    ScanCounters& counters() { return _file; }
+
+    static void dumpJson(FILE* fp, const ScanCounters& counters);
+
+private:
+    ScanCounters _file;
+    ScanCounters _total;    // of the files before _file
+
+    ScanStats();
+
+    static void createKey();
+    static void destroyThread(void* stats);
+};
+
+// Adds the time it is in scope to a ScanCounters field.
+class ScanStatsTimer {
+public:
+    explicit ScanStatsTimer(uint64_t ScanCounters::* field)
+        : _field(field), _start(systemTime(SYSTEM_TIME_MONOTONIC)) {}
+    ~ScanStatsTimer() {
+        ScanStats::thread()->counters().*_field +=
+                systemTime(SYSTEM_TIME_MONOTONIC) - _start;
+    }
+
+private:
+    uint64_t ScanCounters::* _field;
+    nsecs_t _start;
+};
+
+}
+
+#if SCAN_STATS_ENABLED
+#define SCAN_STATS_ADD(field, n) \
+    (android::ScanStats::thread()->counters().field += (n))
+#define SCAN_STATS_TIME(field) \
+    android::ScanStatsTimer __scanStatsTimer(&android::ScanCounters::field)
+#define SCAN_STATS_BEGIN_FILE() android::ScanStats::thread()->beginFile()
+#define SCAN_STATS_END_FILE() android::ScanStats::thread()->endFile()
+#else
+#define SCAN_STATS_ADD(field, n) ((void)0)
+#define SCAN_STATS_TIME(field) ((void)0)
+#define SCAN_STATS_BEGIN_FILE() ((void)0)
+#define SCAN_STATS_END_FILE() ((void)0)
+#endif
+
+#endif // SCAN_STATS_H
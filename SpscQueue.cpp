@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sched.h>
+#include <time.h>
+
+#include <cutils/atomic.h>
+
+#include "SpscQueue.h"
+
+namespace android {
+
+SpscQueue::SpscQueue(size_t capacity)
+    : _head(0),
+      _tail(0)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+    _mask = size - 1;
+    _slots.resize(size);
+}
+
+// The indices run freely and wrap; only their difference and their low
+// bits are used.
+bool SpscQueue::push(void* item)
+{
+    uint32_t tail = (uint32_t)_tail;
+    uint32_t head = (uint32_t)android_atomic_acquire_load(&_head);
+    if (tail - head > _mask)
+        return false;
+    _slots[tail & _mask] = item;
+    android_atomic_release_store((int32_t)(tail + 1), &_tail);
+    return true;
+}
+
+bool SpscQueue::pop(void** item)
+{
+    uint32_t head = (uint32_t)_head;
+    uint32_t tail = (uint32_t)android_atomic_acquire_load(&_tail);
+    if (head == tail)
+        return false;
+    *item = _slots[head & _mask];
+    android_atomic_release_store((int32_t)(head + 1), &_head);
+    return true;
+}
+
+void SpscQueue::wait(int round)
+{
+    if (round < 64)
+        return;
+    if (round < 128) {
+        sched_yield();
+        return;
+    }
+    struct timespec ts = { 0, 50 * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+}
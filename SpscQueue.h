@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace android {
+
+// Bounded lock-free queue of pointers between one producer thread and one
+// consumer thread.
+//
+// The producer only writes _tail and the consumer only writes _head, each
+// published with a release store and read with an acquire load of
+// cutils/atomic.h, so a slot is never read before it's written nor
+// written before it's read. The two indices are on cache lines of their
+// own. Neither side ever blocks: push() fails when full and pop() when
+// empty, and what to do then is the caller's choice; see wait().
+class SpscQueue {
+public:
+    // capacity is rounded up to a power of two.
+    explicit SpscQueue(size_t capacity);
+
+    size_t capacity() const { return _mask + 1; }
+
+    // producer only
+    bool push(void* item);
+    // consumer only
+    bool pop(void** item);
+
+    // Backs off a thread whose push() or pop() failed for the round-th
+    // time in a row: spins first, then yields, then sleeps a little.
+    static void wait(int round);
+
+private:
+    enum { kCacheLine = 64 };
+
+    volatile int32_t _head;     // next to pop
+    char _headPad[kCacheLine - sizeof(int32_t)];
+    volatile int32_t _tail;     // next to push
+    char _tailPad[kCacheLine - sizeof(int32_t)];
+    uint32_t _mask;
+    std::vector<void*> _slots;
+
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+};
+
+}
+
+#endif // SPSC_QUEUE_H
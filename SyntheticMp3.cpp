@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SyntheticMp3"
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SyntheticMp3.h"
+
+namespace android {
+
+// 128 kb/s, 44.1 kHz, no padding: 144 * 128000 / 44100 bytes.
+static const size_t kMpegFrameSize = 417;
+static const char kMpegFrameHeader[] = { '\xFF', '\xFB', '\x90', '\x00' };
+
+static void appendSyncsafe(std::vector<char>* out, uint32_t v)
+{
+    out->push_back((v >> 21) & 0x7F);
+    out->push_back((v >> 14) & 0x7F);
+    out->push_back((v >> 7) & 0x7F);
+    out->push_back(v & 0x7F);
+}
+
+static void appendBigEndian(std::vector<char>* out, uint32_t v)
+{
+    out->push_back(v >> 24);
+    out->push_back(v >> 16);
+    out->push_back(v >> 8);
+    out->push_back(v);
+}
+
+SyntheticMp3::SyntheticMp3()
+{
+    clear();
+}
+
+void SyntheticMp3::clear()
+{
+    _version = 3;
+    _frames.clear();
+    _hasId3v1 = false;
+    memset(_id3v1, 0, sizeof(_id3v1));
+    _audioSize = 0;
+}
+
+void SyntheticMp3::setId3v2Version(int version)
+{
+    _version = version;
+}
+
+void SyntheticMp3::addTextFrame(const char* frameId, Id3TextEncoding encoding,
+                                const char* text, size_t length)
+{
+    Frame frame;
+    strncpy(frame.id, frameId, 4);
+    frame.id[4] = 0;
+    frame.encoding = encoding;
+    frame.text.assign(text, length);
+    _frames.push_back(frame);
+}
+
+void SyntheticMp3::setId3v1(const char* title, const char* artist, const char* album,
+                            const char* year)
+{
+    memset(_id3v1, 0, sizeof(_id3v1));
+    memcpy(_id3v1, "TAG", 3);
+    strncpy(_id3v1 + 3, title, 30);
+    strncpy(_id3v1 + 33, artist, 30);
+    strncpy(_id3v1 + 63, album, 30);
+    strncpy(_id3v1 + 93, year, 4);
+    _id3v1[127] = (char)0xFF;   // no genre
+    _hasId3v1 = true;
+}
+
+void SyntheticMp3::setAudioSize(size_t size)
+{
+    _audioSize = (size + kMpegFrameSize - 1) / kMpegFrameSize * kMpegFrameSize;
+}
+
+void SyntheticMp3::build(std::vector<char>* out) const
+{
+    out->clear();
+
+    if (!_frames.empty()) {
+        size_t tagSize = 0;
+        for (size_t i = 0; i < _frames.size(); i++)
+            tagSize += 10 + 1 + _frames[i].text.size();
+
+        const char header[] = { 'I', 'D', '3', (char)_version, 0, 0 };
+        out->insert(out->end(), header, header + sizeof(header));
+        appendSyncsafe(out, tagSize);
+        for (size_t i = 0; i < _frames.size(); i++) {
+            const Frame& f = _frames[i];
+            out->insert(out->end(), f.id, f.id + 4);
+            if (_version == 4)
+                appendSyncsafe(out, 1 + f.text.size());
+            else
+                appendBigEndian(out, 1 + f.text.size());
+            out->push_back(0);      // flags
+            out->push_back(0);
+            out->push_back(f.encoding);
+            out->insert(out->end(), f.text.begin(), f.text.end());
+        }
+    }
+
+    for (size_t pos = 0; pos < _audioSize; pos += kMpegFrameSize) {
+        out->insert(out->end(), kMpegFrameHeader, kMpegFrameHeader + sizeof(kMpegFrameHeader));
+        out->resize(out->size() + kMpegFrameSize - sizeof(kMpegFrameHeader), 0);
+    }
+
+    if (_hasId3v1)
+        out->insert(out->end(), _id3v1, _id3v1 + sizeof(_id3v1));
+}
+
+status_t SyntheticMp3::write(const char* path) const
+{
+    std::vector<char> data;
+    build(&data);
+
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        LOGE("can't create %s: %s\n", path, strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    bool ok = data.empty() || fwrite(&data[0], data.size(), 1, fp) == 1;
+    if (fclose(fp) != 0)
+        ok = false;
+    return ok ? OK : UNKNOWN_ERROR;
+}
+
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHETIC_MP3_H
+#define SYNTHETIC_MP3_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <utils/Errors.h>
+
+#include "Id3Reader.h"
+
+namespace android {
+
+// Writes MP3 files for Id3Reader to read: an ID3v2.3 or 2.4 tag of
+// text frames, silent MPEG-1 layer III frames and an ID3v1 tag, any of
+// them optional. Values are written as bytes in the encoding given, so
+// native strings go in as kId3Latin1, the way tagging software that
+// isn't Unicode aware wrote them.
+class SyntheticMp3 {
+public:
+    SyntheticMp3();
+
+    void clear();
+
+    // 3 or 4; the default is 3.
+    void setId3v2Version(int version);
+
+    void addTextFrame(const char* frameId, Id3TextEncoding encoding,
+                      const char* text, size_t length);
+
+    // fields longer than ID3v1 has room for are cut.
+    void setId3v1(const char* title, const char* artist, const char* album,
+                  const char* year);
+
+    // rounded up to whole 417 byte frames of 128 kb/s at 44.1 kHz.
+    void setAudioSize(size_t size);
+
+    // The whole file as write() writes it.
+    void build(std::vector<char>* out) const;
+
+    status_t write(const char* path) const;
+
+private:
+    struct Frame {
+        char id[5];
+        Id3TextEncoding encoding;
+        std::string text;
+    };
+
+    int _version;
+    std::vector<Frame> _frames;
+    bool _hasId3v1;
+    char _id3v1[128];
+    size_t _audioSize;
+};
+
+}
+
+#endif // SYNTHETIC_MP3_H
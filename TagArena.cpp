@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "TagArena.h"
+
+namespace android {
+
+TagArena::TagArena(size_t chunkSize)
+    : _chunkSize(chunkSize),
+      _current(0),
+      _offset(0),
+      _used(0),
+      _capacity(0)
+{
+}
+
+TagArena::~TagArena()
+{
+    release();
+}
+
+char* TagArena::allocate(size_t size)
+{
+    if (_current < _chunks.size() && _chunks[_current].size - _offset >= size) {
+        char* p = _chunks[_current].data + _offset;
+        _offset += size;
+        _used += size;
+        return p;
+    }
+
+    // move on to the next kept chunk that is big enough. Chunks skipped
+    // here are only wasted until the next reset().
+    for (size_t i = _current + 1; i < _chunks.size(); i++) {
+        if (_chunks[i].size >= size) {
+            _current = i;
+            _offset = size;
+            _used += size;
+            return _chunks[i].data;
+        }
+    }
+
+    Chunk chunk;
+    chunk.size = size > _chunkSize ? size : _chunkSize;
+    chunk.data = new char[chunk.size];
+    if (!chunk.data)
+        return NULL;
+    _chunks.push_back(chunk);
+    _capacity += chunk.size;
+
+    _current = _chunks.size() - 1;
+    _offset = size;
+    _used += size;
+    return chunk.data;
+}
+
+char* TagArena::copy(const char* src, size_t len)
+{
+    char* p = allocate(len + 1);
+    if (!p)
+        return NULL;
+    memcpy(p, src, len);
+    p[len] = 0;
+    return p;
+}
+
+void TagArena::reset()
+{
+    _current = 0;
+    _offset = 0;
+    _used = 0;
+}
+
+void TagArena::release()
+{
+    for (size_t i = 0; i < _chunks.size(); i++)
+        delete[] _chunks[i].data;
+    _chunks.clear();
+    _capacity = 0;
+    reset();
+}
+
+}
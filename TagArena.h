@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TAG_ARENA_H
+#define TAG_ARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace android {
+
+// Bump allocator for the bytes of one scanned file.
+//
+// allocate() hands out memory from a list of chunks; reset() rewinds to
+// the first chunk without freeing anything, so once the arena has grown
+// to the size of the largest file, scanning more files allocates nothing.
+// Pointers returned by allocate() are valid until the next reset() or
+// release().
+class TagArena {
+public:
+    enum { kDefaultChunkSize = 4096 };
+
+    explicit TagArena(size_t chunkSize = kDefaultChunkSize);
+    ~TagArena();
+
+    // Returns size bytes, or NULL if out of memory.
+    char* allocate(size_t size);
+
+    // Copies len bytes of src and a terminating zero into the arena.
+    char* copy(const char* src, size_t len);
+
+    // Makes every chunk available again, keeping them allocated.
+    void reset();
+
+    // Frees every chunk.
+    void release();
+
+    // Bytes handed out since the last reset().
+    size_t bytesUsed() const { return _used; }
+
+    // Bytes held in chunks.
+    size_t capacity() const { return _capacity; }
+
+private:
+    struct Chunk {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Chunk> _chunks;
+    size_t _chunkSize;
+    size_t _current;    // chunk allocate() bumps in
+    size_t _offset;     // first free byte of _chunks[_current]
+    size_t _used;
+    size_t _capacity;
+
+    // not copyable
+    TagArena(const TagArena&);
+    TagArena& operator=(const TagArena&);
+};
+
+}
+
+#endif // TAG_ARENA_H
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TagConverter"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include <unicode/ucnv.h>
+
+#include "ConverterCache.h"
+#include "Latin1Utf8.h"
+#include "NativeEncodingDetector.h"
+#include "ScanStats.h"
+#include "TagConverter.h"
+#include "TagPrescreen.h"
+
+namespace android {
+
+// what a chopped trailing lead byte becomes.
+static const char kReplacementChar[] = "\xEF\xBF\xBD";
+
+TagConverter::TagConverter(MediaScannerClient* client)
+    : _client(client),
+      _handler(NULL),
+      _cache(NULL),
+      _album(NULL),
+      _localeEncoding(kNativeEncodingNone),
+      _fileEncodings(kNativeEncodingAll),
+      _isLazy(false),
+      _isNativeFile(false)
+{
+}
+
+void TagConverter::setLocale(const char* locale)
+{
+    // like MediaScannerClient, an unknown locale keeps the previous one.
+    NativeEncoding encoding = localeNativeEncoding(locale);
+    if (encoding != kNativeEncodingNone)
+        _localeEncoding = encoding;
+}
+
+void TagConverter::setDetectionCache(DetectionCache* cache)
+{
+    _cache = cache;
+}
+
+void TagConverter::setAlbumEncodingVote(AlbumEncodingVote* album)
+{
+    _album = album;
+}
+
+void TagConverter::setTagValueHandler(TagValueHandler* handler)
+{
+    _handler = handler;
+}
+
+void TagConverter::setLazyConversionEnabled(bool enabled)
+{
+    _isLazy = enabled;
+}
+
+// Only the locale encoding decides a file, but the others are kept track
+// of for the cache and the counters until the album has decided.
+uint32_t TagConverter::candidateEncodings() const
+{
+    if (_album && _album->decision() != AlbumEncodingVote::kUndecided)
+        return _localeEncoding;
+    return kNativeEncodingAll;
+}
+
+void TagConverter::beginFile()
+{
+    _arena.reset();
+    _pending.clear();
+    _fileEncodings = kNativeEncodingAll;
+}
+
+// A value that needs no conversion goes to the client as it is. The
+// handler gets it in the arena, copied unless it already is there.
+status_t TagConverter::pass(int nameId, const char* name, const char* value,
+                            size_t valueLength, bool isValueInArena)
+{
+    if (!_handler)
+        return _client->handleStringTag(name, value);
+
+    size_t nameLength = strlen(name);
+    const char* nameView = _arena.copy(name, nameLength);
+    if (!isValueInArena)
+        value = _arena.copy(value, valueLength);
+    if (!nameView || !value)
+        return NO_MEMORY;
+    return _handler->handleStringTagView(nameId, nameView, nameLength, value, valueLength);
+}
+
+// value is in the arena, or in _output without a handler.
+status_t TagConverter::deliver(const PendingTag& tag, const char* value, size_t valueLength)
+{
+    if (!_handler)
+        return _client->handleStringTag(tag.name, value);
+    return _handler->handleStringTagView(tag.nameId, tag.name, tag.nameLength,
+                                         value, valueLength);
+}
+
+// Where the converted values of a file are written: _output, reused for
+// every file, for the client, which copies them; the arena for a
+// handler, which may not.
+char* TagConverter::outputBuffer(size_t size)
+{
+    if (_handler)
+        return _arena.allocate(size);
+    if (_output.size() < size)
+        _output.resize(size);
+    return &_output[0];
+}
+
+status_t TagConverter::addStringTag(const char* name, const char* value)
+{
+    return addStringTag(-1, name, value);
+}
+
+status_t TagConverter::addStringTag(int nameId, const char* name, const char* value)
+{
+    size_t len = strlen(value);
+    if (_localeEncoding == kNativeEncodingNone ||
+        classifyTagValue(value, len) != kTagNeedsDetection)
+        return pass(nameId, name, value, len, false);
+
+    char* native = _arena.allocate(len + 1);
+    if (!native)
+        return NO_MEMORY;
+    int nativeLength = narrowLatin1(value, len, native);
+    if (nativeLength < 0)
+        return pass(nameId, name, value, len, false);
+    native[nativeLength] = 0;
+
+    // UTF-8 that went through a Latin-1 to UTF-8 conversion once more.
+    if (isValidUtf8(native, nativeLength))
+        return pass(nameId, name, native, nativeLength, true);
+
+    NativeEncodingScan scan;
+    uint32_t candidates = candidateEncodings();
+    if (candidates != kNativeEncodingAll) {
+        scan = scanNativeEncodings(native, nativeLength, candidates);
+    } else if (!_cache || !_cache->lookupScan(_localeEncoding, native, nativeLength, &scan)) {
+        scan = scanNativeEncodings(native, nativeLength);
+        if (_cache)
+            _cache->storeScan(_localeEncoding, native, nativeLength, scan);
+    }
+    _fileEncodings &= scan.possible;
+    SCAN_STATS_ADD(detectedTags, 1);
+    SCAN_STATS_ADD(candidateEncodings, __builtin_popcount(scan.possible));
+
+    PendingTag tag;
+    tag.nameId = nameId;
+    tag.nameLength = strlen(name);
+    tag.name = _arena.copy(name, tag.nameLength);
+    if (!tag.name)
+        return NO_MEMORY;
+    tag.native = native;
+    tag.nativeLength = nativeLength;
+    tag.truncated = scan.truncated;
+    tag.value = NULL;
+    tag.valueLength = 0;
+    _pending.push_back(tag);
+    return OK;
+}
+
+status_t TagConverter::addStringTags(const StringTag* tags, size_t count)
+{
+    if (_localeEncoding == kNativeEncodingNone || _cache) {
+        for (size_t i = 0; i < count; i++) {
+            status_t result = addStringTag(tags[i].nameId, tags[i].name, tags[i].value);
+            if (result != OK)
+                return result;
+        }
+        return OK;
+    }
+
+    // clean values go right away; the lengths of the others are kept.
+    size_t first = _pending.size();
+    size_t bufferLength = 0;
+    _lengths.clear();
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strlen(tags[i].value);
+        if (classifyTagValue(tags[i].value, len) != kTagNeedsDetection) {
+            status_t result = pass(tags[i].nameId, tags[i].name, tags[i].value, len, false);
+            if (result != OK)
+                return result;
+            len = (size_t)-1;
+        } else {
+            bufferLength += len + 1;
+        }
+        _lengths.push_back(len);
+    }
+    if (bufferLength == 0)
+        return OK;
+
+    // the others are narrowed back to back; _lengths ends up holding the
+    // lengths of the values in the buffer.
+    char* buffer = _arena.allocate(bufferLength);
+    if (!buffer)
+        return NO_MEMORY;
+    char* native = buffer;
+    size_t scanned = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = _lengths[i];
+        if (len == (size_t)-1)
+            continue;
+        const StringTag& t = tags[i];
+        int nativeLength = narrowLatin1(t.value, len, native);
+        status_t result = OK;
+        if (nativeLength < 0) {
+            result = pass(t.nameId, t.name, t.value, len, false);
+        } else if (isValidUtf8(native, nativeLength)) {
+            // copied, as the space is reused by the next value.
+            native[nativeLength] = 0;
+            result = pass(t.nameId, t.name, native, nativeLength, false);
+        } else {
+            native[nativeLength] = 0;
+            PendingTag tag;
+            tag.nameId = t.nameId;
+            tag.nameLength = strlen(t.name);
+            tag.name = _arena.copy(t.name, tag.nameLength);
+            if (!tag.name)
+                return NO_MEMORY;
+            tag.native = native;
+            tag.nativeLength = nativeLength;
+            tag.truncated = 0;
+            tag.value = NULL;
+            tag.valueLength = 0;
+            _pending.push_back(tag);
+            _lengths[scanned++] = nativeLength;
+            native += nativeLength + 1;
+        }
+        if (result != OK)
+            return result;
+    }
+    if (scanned == 0)
+        return OK;
+
+    _truncated.resize(scanned);
+    uint32_t possible = scanNativeEncodingValues(buffer, &_lengths[0], scanned, &_truncated[0],
+                                                 candidateEncodings());
+    for (size_t i = 0; i < scanned; i++)
+        _pending[first + i].truncated = _truncated[i];
+    _fileEncodings &= possible;
+    SCAN_STATS_ADD(detectedTags, scanned);
+    SCAN_STATS_ADD(candidateEncodings, scanned * __builtin_popcount(possible));
+    return OK;
+}
+
+status_t TagConverter::addUtf16StringTag(int nameId, const char* name, const char* bytes,
+                                         size_t length, Utf16ByteOrder order)
+{
+    char* value = _arena.allocate(utf16Utf8Bound(length) + 1);
+    if (!value)
+        return NO_MEMORY;
+    char* end = utf16ToUtf8(bytes, length, order, value);
+    *end = 0;
+    return pass(nameId, name, value, end - value, true);
+}
+
+// Room a converted or widened value may take, with its zero.
+size_t TagConverter::convertedSize(const PendingTag& tag) const
+{
+    size_t len = tag.nativeLength;
+    return _isNativeFile ? len * 3 + sizeof(kReplacementChar) : len * 2 + 1;
+}
+
+// Converts tag to *target, and moves it past the zero terminating it.
+status_t TagConverter::convertPending(const PendingTag& tag, char** target,
+                                      const char** value, size_t* valueLength)
+{
+    if (_cache) {
+        const char* cached = _cache->lookupConverted(_localeEncoding,
+                                                     tag.native, tag.nativeLength);
+        if (cached) {
+            size_t cachedLength = strlen(cached);
+            // the cache only keeps it until its next store.
+            if (_handler) {
+                memcpy(*target, cached, cachedLength + 1);
+                cached = *target;
+                *target += cachedLength + 1;
+            }
+            *value = cached;
+            *valueLength = cachedLength;
+            return OK;
+        }
+    }
+
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter* conv = ConverterCache::get(nativeEncodingCharset(
+            (NativeEncoding)_localeEncoding), &status);
+    UConverter* utf8Conv = ConverterCache::get("UTF-8", &status);
+    if (U_FAILURE(status))
+        return UNKNOWN_ERROR;
+
+    // leave an unfinished last char to kReplacementChar, not to ICU's
+    // substitution byte.
+    bool isTruncated = (tag.truncated & _localeEncoding) != 0;
+    const char* src = tag.native;
+    size_t len = tag.nativeLength - (isTruncated ? 1 : 0);
+    char* output = *target;
+    char* end = output;
+
+    SCAN_STATS_ADD(bytesConverted, len);
+    ucnv_convertEx(utf8Conv, conv, &end, end + len * 3 + sizeof(kReplacementChar),
+                   &src, src + len, NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
+    if (U_FAILURE(status)) {
+        LOGE("ucnv_convertEx failed: %d\n", status);
+        *value = "???";
+        *valueLength = 3;
+        return OK;
+    }
+    if (isTruncated) {
+        memcpy(end, kReplacementChar, sizeof(kReplacementChar) - 1);
+        end += sizeof(kReplacementChar) - 1;
+    }
+    *end = 0;
+    *target = end + 1;
+
+    if (_cache) {
+        _cache->storeConverted(_localeEncoding, tag.native, tag.nativeLength,
+                               output, end - output);
+    }
+
+    *value = output;
+    *valueLength = end - output;
+    return OK;
+}
+
+// back to the value addStringTag() was given, at *target as above.
+status_t TagConverter::widenPending(const PendingTag& tag, char** target,
+                                    const char** value, size_t* valueLength)
+{
+    SCAN_STATS_ADD(latin1Fallbacks, 1);
+    char* output = *target;
+    char* end = latin1ToUtf8(tag.native, tag.nativeLength, output);
+    *end = 0;
+    *target = end + 1;
+
+    *value = output;
+    *valueLength = end - output;
+    return OK;
+}
+
+// A file tells Latin-1 if a tag isn't well formed in the locale
+// encoding, and the locale encoding if none is chopped and there are
+// kMinEvidenceBytes of native text. One that can't tell follows the
+// album, if it has decided.
+void TagConverter::voteOnFile()
+{
+    AlbumEncodingVote::Decision own = AlbumEncodingVote::kLatin1;
+    if (_isNativeFile) {
+        size_t nativeBytes = 0;
+        bool isTruncated = false;
+        for (size_t i = 0; i < _pending.size(); i++) {
+            const PendingTag& tag = _pending[i];
+            for (size_t j = 0; j < tag.nativeLength; j++)
+                nativeBytes += (uint8_t)tag.native[j] >> 7;
+            if (tag.truncated & _localeEncoding)
+                isTruncated = true;
+        }
+        own = !isTruncated && nativeBytes >= kMinEvidenceBytes ?
+                AlbumEncodingVote::kLocaleEncoding : AlbumEncodingVote::kUndecided;
+    }
+
+    AlbumEncodingVote::Decision album = _album->decision();
+    if (album != AlbumEncodingVote::kUndecided) {
+        bool follows = own == AlbumEncodingVote::kUndecided;
+        if (follows)
+            _isNativeFile = album == AlbumEncodingVote::kLocaleEncoding;
+        _album->countDecidedFile(follows);
+    }
+    _album->vote(own);
+}
+
+// Every pending tag goes into one buffer, sized for the worst case. Lazy
+// ones stay pending until beginFile().
+status_t TagConverter::endFile()
+{
+    _isNativeFile = (_fileEncodings & _localeEncoding) != 0;
+    if (_album && !_pending.empty())
+        voteOnFile();
+    status_t result = OK;
+
+    if (_isLazy && _handler) {
+        for (size_t i = 0; i < _pending.size() && result == OK; i++) {
+            const PendingTag& tag = _pending[i];
+            result = _handler->handleLazyStringTag(tag.nameId, tag.name, tag.nameLength, i);
+        }
+        return result;
+    }
+
+    size_t outputLength = 0;
+    for (size_t i = 0; i < _pending.size(); i++)
+        outputLength += convertedSize(_pending[i]);
+    char* target = _pending.empty() ? NULL : outputBuffer(outputLength);
+    if (!_pending.empty() && !target)
+        result = NO_MEMORY;
+
+    for (size_t i = 0; i < _pending.size() && result == OK; i++) {
+        const char* value;
+        size_t valueLength;
+        if (_isNativeFile)
+            result = convertPending(_pending[i], &target, &value, &valueLength);
+        else
+            result = widenPending(_pending[i], &target, &value, &valueLength);
+        if (result == OK)
+            result = deliver(_pending[i], value, valueLength);
+    }
+
+    _pending.clear();
+    return result;
+}
+
+const char* TagConverter::lazyValue(size_t index, size_t* len)
+{
+    if (index >= _pending.size())
+        return NULL;
+
+    PendingTag& tag = _pending[index];
+    if (!tag.value) {
+        char* target = _arena.allocate(convertedSize(tag));
+        if (!target)
+            return NULL;
+        status_t result;
+        if (_isNativeFile)
+            result = convertPending(tag, &target, &tag.value, &tag.valueLength);
+        else
+            result = widenPending(tag, &target, &tag.value, &tag.valueLength);
+        if (result != OK) {
+            tag.value = NULL;
+            return NULL;
+        }
+    }
+    if (len)
+        *len = tag.valueLength;
+    return tag.value;
+}
+
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TAG_CONVERTER_H
+#define TAG_CONVERTER_H
+
+#include <vector>
+
+#include <media/mediascanner.h>
+
+#include "AlbumEncodingVote.h"
+#include "DetectionCache.h"
+#include "TagArena.h"
+#include "Utf16Utf8.h"
+
+namespace android {
+
+// A tag of a batch given to TagConverter::addStringTags().
+struct StringTag {
+    int nameId;             // -1 if none
+    const char* name;
+    const char* value;
+};
+
+// Length-aware variant of MediaScannerClient::handleStringTag().
+//
+// name and value are views into the TagConverter's arena, zero
+// terminated, and stay valid until the next beginFile(), so a handler can
+// keep them instead of copying. nameId is the one given to
+// TagConverter::addStringTag(), -1 if none was.
+class TagValueHandler {
+public:
+    virtual ~TagValueHandler() {}
+    virtual status_t handleStringTagView(int nameId, const char* name, size_t nameLength,
+                                         const char* value, size_t valueLength) = 0;
+
+    // With lazy conversion, what endFile() gives instead of a converted
+    // value: TagConverter::lazyValue(index) converts it when asked.
+    virtual status_t handleLazyStringTag(int nameId, const char* name, size_t nameLength,
+                                         size_t index) = 0;
+};
+
+// Native encoding detection and conversion of one file's tags, making the
+// decision MediaScannerClient::endFile() makes:
+//
+//  - ASCII and UTF-8 that can't be widened Latin-1 pass unchanged.
+//  - Latin-1 range values are narrowed back to their bytes. Bytes that
+//    are themselves UTF-8 are delivered as such.
+//  - The rest are converted from the locale encoding if every one of them
+//    is well formed in it, and delivered unchanged otherwise.
+//
+// Detection is one scanNativeEncodings() pass per value and ICU is only
+// used for the final conversion, with converters from ConverterCache.
+// Results go to client->handleStringTag(), clean values right away and
+// converted ones from endFile(), as MediaScannerClient does, or to a
+// TagValueHandler if one is set.
+class TagConverter {
+public:
+    explicit TagConverter(MediaScannerClient* client);
+
+    // same rules as MediaScannerClient::setLocale().
+    void setLocale(const char* locale);
+
+    // NativeEncoding of the locale, kNativeEncodingNone before one that
+    // detects.
+    uint32_t localeEncoding() const { return _localeEncoding; }
+
+    // Memoizes detection and conversion across files in cache, which
+    // stays owned by the caller. NULL, the default, disables it.
+    void setDetectionCache(DetectionCache* cache);
+
+    // Lets the files of an album decide together; see AlbumEncodingVote.
+    // endFile() votes with each file, and follows the album with those
+    // that can't tell. Stays owned by the caller; NULL, the default,
+    // decides every file alone. Only change it between files.
+    void setAlbumEncodingVote(AlbumEncodingVote* album);
+
+    // Delivers results to handler instead of client->handleStringTag().
+    // NULL, the default, goes back to the client. Only change it between
+    // files.
+    void setTagValueHandler(TagValueHandler* handler);
+
+    // With lazy conversion endFile() only decides how the values that
+    // needed detection are converted, and hands them to the handler's
+    // handleLazyStringTag(). Each is converted by its first lazyValue(),
+    // which keeps the result. Without a handler, endFile() converts as
+    // usual. Only change it between files.
+    void setLazyConversionEnabled(bool enabled);
+
+    // The index-th value handleLazyStringTag() was given, converted, or
+    // NULL if there's no such value or no memory. Valid until the next
+    // beginFile(); len may be NULL.
+    const char* lazyValue(size_t index, size_t* len = NULL);
+
+    void beginFile();
+    status_t addStringTag(const char* name, const char* value);
+    status_t addStringTag(int nameId, const char* name, const char* value);
+
+    // The same as addStringTag() on each tag in turn, but the values that
+    // need detection are narrowed into one buffer and scanned in a single
+    // pass. Without a cache, it's meant for all the tags of a file at once.
+    status_t addStringTags(const StringTag* tags, size_t count);
+
+    // A UTF-16 value, as an ID3v2 text frame has it; see utf16ToUtf8().
+    // It can't be native bytes, so it skips detection and goes out
+    // right away as UTF-8.
+    status_t addUtf16StringTag(int nameId, const char* name, const char* bytes,
+                               size_t length, Utf16ByteOrder order);
+
+    status_t endFile();
+
+private:
+    struct PendingTag {
+        int nameId;
+        const char* name;
+        size_t nameLength;
+        const char* native;     // narrowed bytes, zero terminated
+        size_t nativeLength;
+        uint32_t truncated;     // encodings it ends in the middle of a char in
+        const char* value;      // converted by lazyValue(), else NULL
+        size_t valueLength;
+    };
+
+    MediaScannerClient* _client;
+    TagValueHandler* _handler;
+    DetectionCache* _cache;
+    AlbumEncodingVote* _album;
+    uint32_t _localeEncoding;
+    uint32_t _fileEncodings;    // encodings every pending tag is well formed in
+    bool _isLazy;
+    bool _isNativeFile;         // endFile()'s decision for the pending tags
+    TagArena _arena;
+    std::vector<PendingTag> _pending;
+    std::vector<char> _output;     // without a handler
+    // of the values of a batch, for scanNativeEncodingValues()
+    std::vector<size_t> _lengths;
+    std::vector<uint32_t> _truncated;
+
+    // a file with fewer bytes of native text than this can't tell.
+    enum { kMinEvidenceBytes = 4 };
+
+    uint32_t candidateEncodings() const;
+    void voteOnFile();
+    status_t pass(int nameId, const char* name, const char* value, size_t valueLength,
+                  bool isValueInArena);
+    status_t deliver(const PendingTag& tag, const char* value, size_t valueLength);
+    char* outputBuffer(size_t size);
+    size_t convertedSize(const PendingTag& tag) const;
+    status_t convertPending(const PendingTag& tag, char** target,
+                            const char** value, size_t* valueLength);
+    status_t widenPending(const PendingTag& tag, char** target,
+                          const char** value, size_t* valueLength);
+
+    // not copyable
+    TagConverter(const TagConverter&);
+    TagConverter& operator=(const TagConverter&);
+};
+
+}
+
+#endif // TAG_CONVERTER_H
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "TagNameTable.h"
+
+namespace android {
+
+// a file has a few dozen distinct names at most.
+static const size_t kInitialBuckets = 64;
+
+TagNameTable::TagNameTable()
+    : _arena(1024),
+      _buckets(kInitialBuckets, -1)
+{
+}
+
+// FNV-1a
+uint32_t TagNameTable::hash(const char* name, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int32_t TagNameTable::intern(const char* name, size_t len)
+{
+    size_t mask = _buckets.size() - 1;
+    size_t b = hash(name, len) & mask;
+    for (; _buckets[b] >= 0; b = (b + 1) & mask) {
+        int32_t i = _buckets[b];
+        if (_lengths[i] == len && !memcmp(_names[i], name, len))
+            return kFirstNamedTagId + i;
+    }
+
+    const char* copy = _arena.copy(name, len);
+    if (!copy)
+        return -1;
+    int32_t i = _names.size();
+    _names.push_back(copy);
+    _lengths.push_back(len);
+    _buckets[b] = i;
+
+    // at most half full
+    if (_names.size() * 2 > _buckets.size())
+        grow();
+    return kFirstNamedTagId + i;
+}
+
+const char* TagNameTable::name(int32_t id) const
+{
+    if (id < kFirstNamedTagId || (size_t)(id - kFirstNamedTagId) >= _names.size())
+        return NULL;
+    return _names[id - kFirstNamedTagId];
+}
+
+void TagNameTable::grow()
+{
+    _buckets.assign(_buckets.size() * 2, -1);
+    size_t mask = _buckets.size() - 1;
+    for (size_t i = 0; i < _names.size(); i++) {
+        size_t b = hash(_names[i], _lengths[i]) & mask;
+        while (_buckets[b] >= 0)
+            b = (b + 1) & mask;
+        _buckets[b] = i;
+    }
+}
+
+}
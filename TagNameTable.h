@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TAG_NAME_TABLE_H
+#define TAG_NAME_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "TagArena.h"
+
+namespace android {
+
+// Interns tag names to numeric ids.
+//
+// A name is hashed and compared once, when it comes in; from there on the
+// tag is its id, and results are grouped and sorted on integers. Ids are
+// handed out from kFirstNamedTagId up, above the decimal indices the
+// tests name their tags with, so both can share one id space.
+class TagNameTable {
+public:
+    enum { kFirstNamedTagId = 1 << 30 };
+
+    TagNameTable();
+
+    // The id of name, a new one the first time it is seen, or -1 if out
+    // of memory.
+    int32_t intern(const char* name, size_t len);
+
+    // The zero terminated name of id, or NULL if it isn't one.
+    const char* name(int32_t id) const;
+
+    size_t size() const { return _names.size(); }
+
+private:
+    TagArena _arena;
+    std::vector<const char*> _names;    // by id - kFirstNamedTagId
+    std::vector<uint32_t> _lengths;
+    std::vector<int32_t> _buckets;      // index into _names, or -1
+
+    static uint32_t hash(const char* name, size_t len);
+    void grow();
+
+    TagNameTable(const TagNameTable&);
+    TagNameTable& operator=(const TagNameTable&);
+};
+
+}
+
+#endif // TAG_NAME_TABLE_H
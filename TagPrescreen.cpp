@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "TagPrescreen.h"
+
+namespace android {
+
+size_t asciiPrefixLength(const char* s, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)s;
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(v);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(v);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON__)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(p + i);
+        uint8x8_t m = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+        if (vget_lane_u64(vreinterpret_u64_u8(m), 0) & 0x8080808080808080ULL)
+            break;      // the word loop below finds the byte
+    }
+#endif
+
+    for (; i + 4 <= len; i += 4) {
+        uint32_t word;
+        memcpy(&word, p + i, 4);
+        if (word & 0x80808080)
+            break;
+    }
+    for (; i < len; i++) {
+        if (p[i] & 0x80)
+            break;
+    }
+    return i;
+}
+
+// Decodes one multi-byte sequence at p[0] (p[0] >= 0x80). Returns its
+// length, or 0 if it isn't well formed UTF-8.
+static size_t decodeUtf8(const uint8_t* p, size_t len, uint32_t* codePoint)
+{
+    uint8_t c = p[0];
+    size_t n;
+    uint32_t cp, min;
+
+    if (c >= 0xC2 && c <= 0xDF) {
+        n = 2; cp = c & 0x1F; min = 0x80;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        n = 3; cp = c & 0x0F; min = 0x800;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        n = 4; cp = c & 0x07; min = 0x10000;
+    } else {
+        return 0;
+    }
+    if (n > len)
+        return 0;
+    for (size_t k = 1; k < n; k++) {
+        if ((p[k] & 0xC0) != 0x80)
+            return 0;
+        cp = (cp << 6) | (p[k] & 0x3F);
+    }
+    // overlong forms, surrogates and values past U+10FFFF
+    if (cp < min || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+        return 0;
+
+    *codePoint = cp;
+    return n;
+}
+
+TagClass classifyTagValue(const char* value, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)value;
+    bool hasWide = false;
+    size_t i = asciiPrefixLength(value, len);
+
+    if (i == len)
+        return kTagAscii;
+
+    while (i < len) {
+        uint32_t cp;
+        size_t n = decodeUtf8(p + i, len - i, &cp);
+        if (n == 0)
+            return kTagNeedsDetection;
+        if (cp > 0xFF)
+            hasWide = true;
+        i += n;
+        i += asciiPrefixLength(value + i, len - i);
+    }
+
+    return hasWide ? kTagUtf8 : kTagNeedsDetection;
+}
+
+bool isValidUtf8(const char* s, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)s;
+    size_t i = asciiPrefixLength(s, len);
+
+    while (i < len) {
+        uint32_t cp;
+        size_t n = decodeUtf8(p + i, len - i, &cp);
+        if (n == 0)
+            return false;
+        i += n;
+        i += asciiPrefixLength(s + i, len - i);
+    }
+    return true;
+}
+
+int narrowLatin1(const char* value, size_t len, char* out)
+{
+    const uint8_t* p = (const uint8_t*)value;
+    size_t i = 0;
+    int n = 0;
+
+    while (i < len) {
+        size_t ascii = asciiPrefixLength(value + i, len - i);
+        memcpy(out + n, value + i, ascii);
+        n += ascii;
+        i += ascii;
+        if (i == len)
+            break;
+        // U+0080..U+00FF is C2 or C3 and one continuation byte.
+        if ((p[i] != 0xC2 && p[i] != 0xC3) || i + 1 == len || (p[i + 1] & 0xC0) != 0x80)
+            return -1;
+        out[n++] = (char)(((p[i] & 0x03) << 6) | (p[i + 1] & 0x3F));
+        i += 2;
+    }
+    return n;
+}
+
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TAG_PRESCREEN_H
+#define TAG_PRESCREEN_H
+
+#include <stddef.h>
+
+namespace android {
+
+// What MediaScannerClient's native encoding detection can do to a value.
+enum TagClass {
+    // only 7-bit bytes, never touched by detection.
+    kTagAscii,
+    // valid UTF-8 with a code point above U+00FF. It can't be native bytes
+    // that were widened as Latin-1, so detection leaves it as it is.
+    kTagUtf8,
+    // anything else: Latin-1 range UTF-8, which may hide native bytes,
+    // or bytes that aren't UTF-8 at all.
+    kTagNeedsDetection,
+};
+
+// Number of leading bytes of s below 0x80. Uses AVX2, SSE2 or NEON when
+// the target has it, a word at a time otherwise.
+size_t asciiPrefixLength(const char* s, size_t len);
+
+TagClass classifyTagValue(const char* value, size_t len);
+
+bool isValidUtf8(const char* s, size_t len);
+
+// Undoes a Latin-1 to UTF-8 conversion: writes one byte per code point
+// of value to out, which must hold len bytes. Returns the number of
+// bytes written, or -1 if value isn't UTF-8 of code points up to U+00FF.
+int narrowLatin1(const char* value, size_t len, char* out);
+
+}
+
+#endif // TAG_PRESCREEN_H
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include "TagResults.h"
+
+namespace android {
+
+TagResults::TagResults()
+    : _isAscending(true),
+      _isOrdered(true)
+{
+}
+
+status_t TagResults::add(int32_t id, const char* value, size_t len)
+{
+    if (!_ids.empty() && id < _ids.back())
+        _isAscending = false;
+    _isOrdered = false;
+
+    size_t offset = _bytes.size();
+    _bytes.resize(offset + len + 1);
+    memcpy(&_bytes[offset], value, len);
+    _bytes[offset + len] = 0;
+
+    _ids.push_back(id);
+    _offsets.push_back(offset);
+    return OK;
+}
+
+// no bytes, so the length of the value before still comes from the offset
+// after it.
+status_t TagResults::addDeferred(int32_t id, uint32_t token)
+{
+    if (!_ids.empty() && id < _ids.back())
+        _isAscending = false;
+    _isOrdered = false;
+
+    _tokens.resize(_ids.size(), kNotDeferred);
+    _ids.push_back(id);
+    _offsets.push_back(_bytes.size());
+    _tokens.push_back(token);
+    return OK;
+}
+
+void TagResults::clear()
+{
+    _ids.clear();
+    _offsets.clear();
+    _bytes.clear();
+    _tokens.clear();
+    _order.clear();
+    _isAscending = true;
+    _isOrdered = true;
+}
+
+void TagResults::release()
+{
+    std::vector<int32_t>().swap(_ids);
+    std::vector<uint32_t>().swap(_offsets);
+    std::vector<char>().swap(_bytes);
+    std::vector<uint32_t>().swap(_tokens);
+    std::vector<uint32_t>().swap(_order);
+    _isAscending = true;
+    _isOrdered = true;
+}
+
+struct IdOrder {
+    const int32_t* ids;
+    bool operator()(uint32_t a, uint32_t b) const { return ids[a] < ids[b]; }
+};
+
+// Stable, so equal ids stay in the order they were added.
+void TagResults::sort()
+{
+    _order.resize(_ids.size());
+    for (size_t i = 0; i < _order.size(); i++)
+        _order[i] = i;
+
+    IdOrder order;
+    order.ids = &_ids[0];
+    std::stable_sort(_order.begin(), _order.end(), order);
+    _isOrdered = true;
+}
+
+size_t TagResults::count()
+{
+    if (_isAscending)
+        return _ids.size();
+    if (!_isOrdered)
+        sort();
+    return _order.size();
+}
+
+size_t TagResults::position(size_t i)
+{
+    if (_isAscending)
+        return i;
+    if (!_isOrdered)
+        sort();
+    return _order[i];
+}
+
+int32_t TagResults::id(size_t i)
+{
+    if (i >= count())
+        return -1;
+    return _ids[position(i)];
+}
+
+const char* TagResults::value(size_t i, size_t* len)
+{
+    uint32_t token;
+    if (i >= count() || deferred(i, &token))
+        return NULL;
+    size_t p = position(i);
+    size_t end = p + 1 < _offsets.size() ? _offsets[p + 1] : _bytes.size();
+    if (len)
+        *len = end - _offsets[p] - 1;
+    return &_bytes[_offsets[p]];
+}
+
+bool TagResults::deferred(size_t i, uint32_t* token)
+{
+    if (i >= count())
+        return false;
+    size_t p = position(i);
+    if (p >= _tokens.size() || _tokens[p] == kNotDeferred)
+        return false;
+    *token = _tokens[p];
+    return true;
+}
+
+size_t TagResults::capacity() const
+{
+    return _ids.capacity() * sizeof(int32_t) + _offsets.capacity() * sizeof(uint32_t) +
+           _bytes.capacity() + _tokens.capacity() * sizeof(uint32_t) +
+           _order.capacity() * sizeof(uint32_t);
+}
+
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TAG_RESULTS_H
+#define TAG_RESULTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+// The tags of one file as a struct of arrays: the tag ids, where each
+// value starts, and one blob holding the values, each zero terminated.
+//
+// A tag costs its value and two integers; names are left to the ids.
+// Results are read back in the order of their ids, and every tag added
+// is kept: those of the same id, such as two frames a client names
+// alike, in the order they came. Adding in increasing id order, the
+// usual case, needs no sorting at all. clear() keeps the
+// memory for the next file.
+//
+// A deferred tag has no value yet, only a token for whoever will make
+// it; value() is NULL for it.
+class TagResults {
+public:
+    TagResults();
+
+    status_t add(int32_t id, const char* value, size_t len);
+    status_t addDeferred(int32_t id, uint32_t token);
+
+    void clear();
+    void release();
+
+    // tags added since clear()
+    size_t count();
+
+    // of the i-th result in id order. Values are valid until the next
+    // add() or clear().
+    int32_t id(size_t i);
+    const char* value(size_t i, size_t* len = NULL);
+    // whether the i-th result is deferred, and its token if it is.
+    bool deferred(size_t i, uint32_t* token);
+
+    // bytes held
+    size_t capacity() const;
+
+private:
+    std::vector<int32_t> _ids;
+    std::vector<uint32_t> _offsets;     // into _bytes
+    std::vector<char> _bytes;
+    // per tag once one is deferred, kNotDeferred for the others
+    std::vector<uint32_t> _tokens;
+    // positions in id order; unused while the ids come in increasing
+    // order.
+    std::vector<uint32_t> _order;
+    bool _isAscending;
+    bool _isOrdered;
+
+    enum { kNotDeferred = 0xFFFFFFFF };
+
+    size_t position(size_t i);
+    void sort();
+};
+
+}
+
+#endif // TAG_RESULTS_H
@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TESTABLE_MEDIA_SCANNER_CLIENT_H
+#define TESTABLE_MEDIA_SCANNER_CLIENT_H
+
+#include <utils/Log.h>
+
+#include <unicode/ustring.h>
+#include <unicode/ucnv.h>
+#include <media/mediascanner.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "ConverterCache.h"
+#include "Id3Reader.h"
+#include "Latin1Utf8.h"
+#include "NativeEncodingDetector.h"
+#include "ScanStats.h"
+#include "TagConverter.h"
+#include "TagNameTable.h"
+#include "TagPrescreen.h"
+#include "TagResults.h"
+#include "Utf16Utf8.h"
+
+namespace android {
+
+class TestableMediaScannerClient : public MediaScannerClient, public TagValueHandler,
+                                   public Id3TextHandler {
+private:
+    // values of the file by tag id: the index given to
+    // addStringTagWithIdx(), or the interned id of any other name.
+    TagResults _results;
+    TagNameTable _names;
+    std::vector<char> _convBuff;
+    // of addStringTagsWithIdx()
+    std::vector<StringTag> _batchTags;
+    std::vector<char> _batchNames;
+    bool _isPrescreenEnabled;
+    TagConverter _converter;
+    bool _isTagConverterEnabled;
+    ConverterWarmUp _warmUp;
+
+    // tag names of this client are the decimal index of the tag.
+    static bool parseIdx(const char* name, size_t* idx) {
+        size_t n = 0;
+        const char* p = name;
+        if (*p == 0)
+            return false;
+        for (; *p; p++) {
+            if (*p < '0' || *p > '9')
+                return false;
+            n = n * 10 + (*p - '0');
+        }
+        *idx = n;
+        return true;
+    }
+
+    int32_t tagId(const char* name, size_t len) {
+        size_t idx;
+        if (parseIdx(name, &idx) && idx < (size_t)TagNameTable::kFirstNamedTagId)
+            return idx;
+        return _names.intern(name, len);
+    }
+
+    status_t addStringTag(int nameId, const char* name, const char* value) {
+        SCAN_STATS_TIME(addStringTagNs);
+        SCAN_STATS_ADD(tags, 1);
+        if (_isTagConverterEnabled)
+            return _converter.addStringTag(nameId, name, value);
+        // without a locale encoding MediaScannerClient doesn't detect.
+        if (_isPrescreenEnabled && mLocaleEncoding != 0 &&
+            classifyTagValue(value, strlen(value)) != kTagNeedsDetection)
+            return handleStringTag(name, value);
+        return MediaScannerClient::addStringTag(name, value);
+    }
+
+    // MediaScanner's name of an ID3 frame, or the frame ID itself.
+    static const char* id3TagName(const char* frameId) {
+        static const char* const names[][2] = {
+            { "TIT2", "title" }, { "TPE1", "artist" }, { "TPE2", "albumartist" },
+            { "TALB", "album" }, { "TCOM", "composer" }, { "TCON", "genre" },
+            { "TYER", "year" }, { "TDRC", "year" }, { "TRCK", "tracknumber" },
+            { "TPOS", "discnumber" }, { "TCMP", "compilation" },
+        };
+        for (size_t i = 0; i < sizeof(names)/sizeof(names[0]); i++) {
+            if (!strcmp(frameId, names[i][0]))
+                return names[i][1];
+        }
+        return frameId;
+    }
+
+    status_t addUtf16StringTag(int nameId, const char* name, const char* bytes,
+                               size_t length, Utf16ByteOrder order) {
+        SCAN_STATS_TIME(addStringTagNs);
+        SCAN_STATS_ADD(tags, 1);
+        if (_isTagConverterEnabled)
+            return _converter.addUtf16StringTag(nameId, name, bytes, length, order);
+        size_t targetLen = utf16Utf8Bound(length) + 1;
+        if (_convBuff.size() < targetLen)
+            _convBuff.resize(targetLen);
+        *utf16ToUtf8(bytes, length, order, &_convBuff[0]) = 0;
+        return handleStringTag(name, &_convBuff[0]);
+    }
+
+public:
+    TestableMediaScannerClient()
+        : _isPrescreenEnabled(false),
+          _converter(this),
+          _isTagConverterEnabled(false) {}
+
+    // Reads the ID3 tags of the file at path with Id3Reader and adds
+    // them as one file of tags, named by id3TagName().
+    virtual status_t scanFile(const char* path, long long lastModified,
+                              long long fileSize, bool isDirectory, bool noMedia)  {
+        if (isDirectory || noMedia)
+            return OK;
+        Id3Reader reader;
+        status_t result = reader.open(path);
+        if (result != OK)
+            return result;
+        beginFile();
+        result = reader.parse(this);
+        endFile();
+        return result;
+    }
+
+    // Latin-1 and UTF-8 text go through addStringTag(), Latin-1 widened
+    // to UTF-8 first as ID3.cpp does, so detection can narrow it back.
+    // UTF-16 goes through addUtf16StringTag(). Only the first string of
+    // a frame is taken.
+    virtual status_t handleId3Text(const char* frameId, Id3TextEncoding encoding,
+                                   const char* text, size_t length) {
+        const char* name = id3TagName(frameId);
+        if (encoding == kId3Utf16 || encoding == kId3Utf16BigEndian)
+            return addUtf16StringTag(name, text, length, kUtf16BigEndian);
+
+        const char* zero = (const char*)memchr(text, 0, length);
+        if (zero)
+            length = zero - text;
+        size_t targetLen = length * 2 + 1;
+        if (_convBuff.size() < targetLen)
+            _convBuff.resize(targetLen);
+        char* end;
+        if (encoding == kId3Latin1) {
+            end = latin1ToUtf8(text, length, &_convBuff[0]);
+        } else {
+            memcpy(&_convBuff[0], text, length);
+            end = &_convBuff[0] + length;
+        }
+        *end = 0;
+        return addStringTag(name, &_convBuff[0]);
+    }
+
+    // not use this member.
+    virtual status_t setMimeType(const char* mimeType) {
+        return OK;
+    }
+
+    // push a tag's name/value pair to client. It called from addStringTag() and endFile()
+    // for this TestableMediaScannerClient, It copies the value to _results.
+    virtual status_t handleStringTag(const char* name, const char* value) {
+        SCAN_STATS_TIME(handleStringTagNs);
+        int32_t id = tagId(name, strlen(name));
+        if (id < 0)
+            return NO_MEMORY;
+        return _results.add(id, value, strlen(value));
+    }
+
+    // The same with the length known; nameId is the index given to
+    // addStringTagWithIdx().
+    virtual status_t handleStringTagView(int nameId, const char* name, size_t nameLength,
+                                         const char* value, size_t valueLength) {
+        SCAN_STATS_TIME(handleStringTagNs);
+        int32_t id = nameId >= 0 ? nameId : tagId(name, nameLength);
+        if (id < 0)
+            return NO_MEMORY;
+        return _results.add(id, value, valueLength);
+    }
+
+    // Only the index goes to _results; getResult() converts the value.
+    virtual status_t handleLazyStringTag(int nameId, const char* name, size_t nameLength,
+                                         size_t index) {
+        int32_t id = nameId >= 0 ? nameId : tagId(name, nameLength);
+        if (id < 0)
+            return NO_MEMORY;
+        return _results.addDeferred(id, index);
+    }
+
+    void setLocale(const char* locale) {
+        _converter.setLocale(locale);
+        MediaScannerClient::setLocale(locale);
+    }
+
+    // Opens the converters files under the current locale can need,
+    // UTF-8 and the locale's encoding, before the first of them; see
+    // ConverterWarmUp. Call it after setLocale(). In the background it
+    // returns at once, and waitForWarmUp(), or the next warmUp(), waits
+    // for it. Nothing to do for a locale that doesn't detect.
+    status_t warmUp(bool inBackground = false) {
+        const char* charset = nativeEncodingCharset((NativeEncoding)_converter.localeEncoding());
+        if (!charset)
+            return OK;
+        const char* charsets[] = { "UTF-8", charset };
+        return _warmUp.start(charsets, 2, inBackground);
+    }
+
+    void waitForWarmUp() {
+        _warmUp.wait();
+    }
+
+    // results of the previous file are dropped here; their memory is kept
+    // for this one.
+    void beginFile() {
+        SCAN_STATS_BEGIN_FILE();
+        initResults();
+        if (_isTagConverterEnabled)
+            _converter.beginFile();
+        else
+            MediaScannerClient::beginFile();
+    }
+
+    void endFile() {
+        {
+            SCAN_STATS_TIME(endFileNs);
+            if (_isTagConverterEnabled)
+                _converter.endFile();
+            else
+                MediaScannerClient::endFile();
+        }
+        SCAN_STATS_END_FILE();
+    }
+
+    // Detect and convert with this tree's TagConverter instead of
+    // MediaScannerClient. Only change it between files.
+    void setTagConverterEnabled(bool enabled) {
+        _isTagConverterEnabled = enabled;
+    }
+
+    // Take the TagConverter's results as views with handleStringTagView()
+    // instead of copying them in handleStringTag(). Needs the TagConverter.
+    void setTagViewEnabled(bool enabled) {
+        _converter.setTagValueHandler(enabled ? this : NULL);
+    }
+
+    // Leave the values that need detection unconverted until getResult()
+    // reads them; see TagConverter::setLazyConversionEnabled(). Needs tag
+    // views.
+    void setLazyConversionEnabled(bool enabled) {
+        _converter.setLazyConversionEnabled(enabled);
+    }
+
+    // cache across files for the TagConverter; owned by the caller.
+    void setDetectionCache(DetectionCache* cache) {
+        _converter.setDetectionCache(cache);
+    }
+
+    // the album the next files belong to, for the TagConverter; owned by
+    // the caller. See AlbumEncodingVote.
+    void setAlbumEncodingVote(AlbumEncodingVote* album) {
+        _converter.setAlbumEncodingVote(album);
+    }
+
+    // With the prescreen enabled, values that native encoding detection
+    // can't change (see TagClass) go straight to handleStringTag(), so
+    // endFile() only sees the ones it has to look at, and nothing at all
+    // for a file of clean tags. Off by default so the tests exercise
+    // MediaScannerClient itself.
+    void setPrescreenEnabled(bool enabled) {
+        _isPrescreenEnabled = enabled;
+    }
+
+    status_t addStringTag(const char* name, const char* value) {
+        return addStringTag(-1, name, value);
+    }
+
+    // All of a file's tags in one call. The TagConverter detects them in a
+    // single pass; MediaScannerClient gets them one by one.
+    status_t addStringTags(const StringTag* tags, size_t count) {
+        if (!_isTagConverterEnabled) {
+            for (size_t i = 0; i < count; i++) {
+                status_t result = addStringTag(tags[i].nameId, tags[i].name, tags[i].value);
+                if (result != OK)
+                    return result;
+            }
+            return OK;
+        }
+        SCAN_STATS_TIME(addStringTagNs);
+        SCAN_STATS_ADD(tags, count);
+        return _converter.addStringTags(tags, count);
+    }
+
+    // instead of using string tag name, we use the idx the result is
+    // read back with by getResult().
+    bool addStringTagWithIdx(int sortingIdx, const char* value) {
+        char strSortingIdx[16];
+        snprintf(strSortingIdx, sizeof(strSortingIdx), "%d", sortingIdx);
+        return addStringTag(sortingIdx, strSortingIdx, value) == OK;
+    }
+
+    // A UTF-16 value of length bytes, BOM and all, as ID3v2 text
+    // encodings 1 and 2 have it; order is for one without a BOM. It's
+    // converted straight to UTF-8 and, as it can't be native bytes,
+    // handled without native encoding detection.
+    status_t addUtf16StringTag(const char* name, const char* bytes, size_t length,
+                               Utf16ByteOrder order = kUtf16BigEndian) {
+        return addUtf16StringTag(-1, name, bytes, length, order);
+    }
+
+    bool addUtf16StringTagWithIdx(int sortingIdx, const char* bytes, size_t length,
+                                  Utf16ByteOrder order = kUtf16BigEndian) {
+        char strSortingIdx[16];
+        snprintf(strSortingIdx, sizeof(strSortingIdx), "%d", sortingIdx);
+        return addUtf16StringTag(sortingIdx, strSortingIdx, bytes, length, order) == OK;
+    }
+
+    // values as addStringTagWithIdx() or addNativeStringTagWithIdx() on
+    // each, indexed from 0, but through addStringTags(). The converted
+    // values and the names share one buffer each.
+    bool addStringTagsWithIdx(const char* const* values, int count, bool isNative) {
+        const size_t nameSize = 12;
+        _batchTags.resize(count);
+        _batchNames.resize(count * nameSize);
+
+        size_t targetLen = 0;
+        if (isNative) {
+            for (int i = 0; i < count; i++)
+                targetLen += strlen(values[i]) * 2 + 1;
+            if (_convBuff.size() < targetLen)
+                _convBuff.resize(targetLen);
+        }
+
+        char* target = targetLen ? &_convBuff[0] : NULL;
+        for (int i = 0; i < count; i++) {
+            char* name = &_batchNames[i * nameSize];
+            snprintf(name, nameSize, "%d", i);
+            _batchTags[i].nameId = i;
+            _batchTags[i].name = name;
+            _batchTags[i].value = values[i];
+            if (isNative) {
+                _batchTags[i].value = target;
+                target = toLatin1Utf8(values[i], target);
+                if (!target)
+                    return false;
+            }
+        }
+        return addStringTags(count ? &_batchTags[0] : NULL, count) == OK;
+    }
+
+    // ID3.cpp have been convert all native encoding strings to ISO8859-1
+    // To simulate this situaltion turn forceConvertToLatin1 to true.
+    // The output goes to _convBuff, so nothing is allocated per tag once
+    // the buffer has grown to the longest value.
+    bool addNativeStringTagWithIdx(int sortingIdx, const char* value,
+                                   bool forceConvertToLatin1 = true) {
+        if (!forceConvertToLatin1)
+            return addStringTagWithIdx(sortingIdx, value);
+
+        size_t targetLen = strlen(value) * 2 + 1;
+        if (_convBuff.size() < targetLen)
+            _convBuff.resize(targetLen);
+        if (!toLatin1Utf8(value, &_convBuff[0]))
+            return false;
+
+        return addStringTagWithIdx(sortingIdx, &_convBuff[0]);
+    }
+
+    // Writes value read as ISO8859-1 to target as UTF-8, at most twice
+    // its length and a zero. Returns the end, past the zero.
+    // latin1ToUtf8() gives what ICU's "iso_8859_1" converter does.
+    static char* toLatin1Utf8(const char* value, char* target) {
+        target = latin1ToUtf8(value, strlen(value), target);
+        // zero terminate
+        *target++ = 0;
+        return target;
+    }
+
+    void initResults() {
+        _results.clear();
+    }
+
+    void releaseResults() {
+        _results.release();
+    }
+
+    int getResultCount() {
+        return _results.count();
+    }
+
+    // bytes held for results, which stops growing after the largest file.
+    size_t getResultCapacity() const {
+        return _results.capacity();
+    }
+
+    // idx-th result in the order of the indices given to
+    // addStringTagWithIdx(), named tags after them. This is the index
+    // itself when the tags of a file were numbered from 0 without gaps.
+    // NULL past the last result; valid until the next tag is handled.
+    // A lazy value is converted by the first call.
+    const char* getResult(int idx) {
+        if (idx < 0)
+            return NULL;
+        uint32_t index;
+        if (_results.deferred(idx, &index))
+            return _converter.lazyValue(index);
+        return _results.value(idx);
+    }
+
+    // tag id of the idx-th result, -1 past the last one.
+    int32_t getResultId(int idx) {
+        if (idx < 0)
+            return -1;
+        return _results.id(idx);
+    }
+
+    // name of a tag id that isn't an index, NULL for an index.
+    const char* getTagName(int32_t id) const {
+        return _names.name(id);
+    }
+};
+
+}
+
+#endif // TESTABLE_MEDIA_SCANNER_CLIENT_H
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TesteeCorpus"
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TesteeCorpus.h"
+
+namespace android {
+
+TesteeCorpus::TesteeCorpus()
+    : _base(NULL),
+      _size(0),
+      _encodings(NULL),
+      _encodingCount(0)
+{
+}
+
+TesteeCorpus::~TesteeCorpus()
+{
+    close();
+}
+
+status_t TesteeCorpus::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        LOGE("can't open %s: %s\n", path, strerror(errno));
+        return NAME_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Header)) {
+        LOGE("%s is too short for a corpus\n", path);
+        ::close(fd);
+        return BAD_VALUE;
+    }
+
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        LOGE("can't mmap %s: %s\n", path, strerror(errno));
+        return NO_MEMORY;
+    }
+    _base = (const char*)base;
+    _size = st.st_size;
+
+    const Header* header = (const Header*)_base;
+    if (header->magic != kMagic || header->version != kVersion ||
+        header->fileSize != _size) {
+        LOGE("%s is not a version %d corpus\n", path, kVersion);
+        close();
+        return BAD_VALUE;
+    }
+
+    size_t directoryEnd = sizeof(Header) + (size_t)header->encodingCount * sizeof(Encoding);
+    if (directoryEnd > _size) {
+        LOGE("%s: directory past the end of the file\n", path);
+        close();
+        return BAD_VALUE;
+    }
+    _encodings = (const Encoding*)(_base + sizeof(Header));
+    _encodingCount = header->encodingCount;
+
+    for (int i = 0; i < _encodingCount; i++) {
+        const Encoding& e = _encodings[i];
+        uint64_t indexEnd = e.indexOffset + (uint64_t)e.itemCount * sizeof(Item);
+        if (e.indexOffset % sizeof(uint32_t) || indexEnd > _size ||
+            e.nameOffset >= _size ||
+            memchr(_base + e.nameOffset, 0, _size - e.nameOffset) == NULL) {
+            LOGE("%s: encoding %d out of the file\n", path, i);
+            close();
+            return BAD_VALUE;
+        }
+    }
+
+    return OK;
+}
+
+void TesteeCorpus::close()
+{
+    if (_base)
+        munmap((void*)_base, _size);
+    _base = NULL;
+    _size = 0;
+    _encodings = NULL;
+    _encodingCount = 0;
+}
+
+int TesteeCorpus::encodingCount() const
+{
+    return _encodingCount;
+}
+
+const char* TesteeCorpus::encodingName(int encoding) const
+{
+    if (encoding < 0 || encoding >= _encodingCount)
+        return NULL;
+    return _base + _encodings[encoding].nameOffset;
+}
+
+int TesteeCorpus::findEncoding(const char* name) const
+{
+    for (int i = 0; i < _encodingCount; i++) {
+        if (!strcasecmp(encodingName(i), name))
+            return i;
+    }
+    return -1;
+}
+
+uint32_t TesteeCorpus::itemCount(int encoding) const
+{
+    if (encoding < 0 || encoding >= _encodingCount)
+        return 0;
+    return _encodings[encoding].itemCount;
+}
+
+// length bytes at offset and the zero after them, or NULL.
+const char* TesteeCorpus::string(uint32_t offset, uint32_t length) const
+{
+    if ((uint64_t)offset + length >= _size || _base[offset + length] != 0)
+        return NULL;
+    return _base + offset;
+}
+
+const TesteeCorpus::Item* TesteeCorpus::item(int encoding, uint32_t item) const
+{
+    if (encoding < 0 || encoding >= _encodingCount ||
+        item >= _encodings[encoding].itemCount)
+        return NULL;
+    return (const Item*)(_base + _encodings[encoding].indexOffset) + item;
+}
+
+const char* TesteeCorpus::native(int encoding, uint32_t i, size_t* len) const
+{
+    const Item* it = item(encoding, i);
+    const char* s = it ? string(it->nativeOffset, it->nativeLength) : NULL;
+    if (len)
+        *len = s ? it->nativeLength : 0;
+    return s;
+}
+
+const char* TesteeCorpus::utf8(int encoding, uint32_t i, size_t* len) const
+{
+    const Item* it = item(encoding, i);
+    const char* s = it ? string(it->utf8Offset, it->utf8Length) : NULL;
+    if (len)
+        *len = s ? it->utf8Length : 0;
+    return s;
+}
+
+}
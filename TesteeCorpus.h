@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TESTEE_CORPUS_H
+#define TESTEE_CORPUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+// Read-only view of a testee.bin written by make_testee.py.
+//
+// testee.h compiles every string into the binary, which caps the corpus
+// at what a compiler is happy to chew. testee.bin holds the same pairs
+// packed for mmap(), so a corpus of millions of strings opens without
+// reading or copying it:
+//
+//   header     magic "TSTE", version, encoding count, file size
+//   directory  per encoding: name offset, item count, index offset, 0
+//   index      per item: native offset, native length,
+//                        utf-8 offset, utf-8 length
+//   strings    zero terminated, so they can be passed as they are
+//
+// Every field is a little endian uint32_t and every offset is from the
+// start of the file. open() checks the header, the directory and that
+// each index lies in the file; the offsets of an item are checked when
+// it is read.
+class TesteeCorpus {
+public:
+    enum { kMagic = 0x45545354 };   // "TSTE"
+    enum { kVersion = 1 };
+
+    TesteeCorpus();
+    ~TesteeCorpus();
+
+    status_t open(const char* path);
+    void close();
+
+    bool isOpen() const { return _base != NULL; }
+    size_t size() const { return _size; }
+
+    int encodingCount() const;
+    // The python codec name of encoding, e.g. "EUC-KR" or "utf-8".
+    const char* encodingName(int encoding) const;
+    // Returns the index of name compared case-insensitively, or -1.
+    int findEncoding(const char* name) const;
+    uint32_t itemCount(int encoding) const;
+
+    // The zero terminated strings of item, or NULL if the item is out of
+    // range or its offsets don't lie in the file. *len is the length,
+    // 0 with NULL; len may be NULL.
+    const char* native(int encoding, uint32_t item, size_t* len = NULL) const;
+    const char* utf8(int encoding, uint32_t item, size_t* len = NULL) const;
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t encodingCount;
+        uint32_t fileSize;
+    };
+
+    struct Encoding {
+        uint32_t nameOffset;
+        uint32_t itemCount;
+        uint32_t indexOffset;
+        uint32_t reserved;
+    };
+
+    struct Item {
+        uint32_t nativeOffset;
+        uint32_t nativeLength;
+        uint32_t utf8Offset;
+        uint32_t utf8Length;
+    };
+
+    const char* _base;
+    size_t _size;
+    const Encoding* _encodings;
+    int _encodingCount;
+
+    const char* string(uint32_t offset, uint32_t length) const;
+    const Item* item(int encoding, uint32_t item) const;
+
+    TesteeCorpus(const TesteeCorpus&);
+    TesteeCorpus& operator=(const TesteeCorpus&);
+};
+
+}
+
+#endif // TESTEE_CORPUS_H
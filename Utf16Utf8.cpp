@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "Utf16Utf8.h"
+
+namespace android {
+
+static inline uint32_t unitAt(const uint8_t* p, bool isBigEndian)
+{
+    return isBigEndian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+static inline uint8_t* encodeUtf8(uint32_t c, uint8_t* o)
+{
+    if (c < 0x80) {
+        *o++ = c;
+    } else if (c < 0x800) {
+        *o++ = 0xC0 | (c >> 6);
+        *o++ = 0x80 | (c & 0x3F);
+    } else if (c < 0x10000) {
+        *o++ = 0xE0 | (c >> 12);
+        *o++ = 0x80 | ((c >> 6) & 0x3F);
+        *o++ = 0x80 | (c & 0x3F);
+    } else {
+        *o++ = 0xF0 | (c >> 18);
+        *o++ = 0x80 | ((c >> 12) & 0x3F);
+        *o++ = 0x80 | ((c >> 6) & 0x3F);
+        *o++ = 0x80 | (c & 0x3F);
+    }
+    return o;
+}
+
+// Narrows the code units from *i on to *out while they are ASCII other
+// than zero, 8 at a time, and moves both past them.
+static inline void copyAscii(const uint8_t* p, size_t length, bool isBigEndian,
+                             size_t* i, uint8_t** out)
+{
+    size_t k = *i;
+    uint8_t* o = *out;
+
+#if defined(__SSE2__)
+    const __m128i high = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    for (; k + 16 <= length; k += 16, o += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + k));
+        if (isBigEndian)
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        __m128i notAscii = _mm_or_si128(
+                _mm_cmpeq_epi16(v, zero),
+                _mm_xor_si128(_mm_cmpeq_epi16(_mm_and_si128(v, high), zero),
+                              _mm_set1_epi16(-1)));
+        if (_mm_movemask_epi8(notAscii))
+            break;
+        _mm_storel_epi64((__m128i*)o, _mm_packus_epi16(v, v));
+    }
+#elif defined(__ARM_NEON__)
+    for (; k + 16 <= length; k += 16, o += 8) {
+        uint8x16_t bytes = vld1q_u8(p + k);
+        if (isBigEndian)
+            bytes = vrev16q_u8(bytes);
+        uint16x8_t v = vreinterpretq_u16_u8(bytes);
+        uint16x8_t notAscii = vorrq_u16(vceqq_u16(v, vdupq_n_u16(0)),
+                                        vcgeq_u16(v, vdupq_n_u16(0x80)));
+        uint16x4_t m = vorr_u16(vget_low_u16(notAscii), vget_high_u16(notAscii));
+        if (vget_lane_u64(vreinterpret_u64_u16(m), 0))
+            break;
+        vst1_u8(o, vmovn_u16(v));
+    }
+#endif
+
+    for (; k + 2 <= length; k += 2) {
+        uint32_t c = unitAt(p + k, isBigEndian);
+        if (c == 0 || c >= 0x80)
+            break;
+        *o++ = c;
+    }
+
+    *i = k;
+    *out = o;
+}
+
+char* utf16ToUtf8(const char* bytes, size_t length, Utf16ByteOrder order, char* out)
+{
+    const uint8_t* p = (const uint8_t*)bytes;
+    uint8_t* o = (uint8_t*)out;
+    bool isBigEndian = order == kUtf16BigEndian;
+    size_t i = 0;
+
+    if (length >= 2) {
+        if (p[0] == 0xFE && p[1] == 0xFF) {
+            isBigEndian = true;
+            i = 2;
+        } else if (p[0] == 0xFF && p[1] == 0xFE) {
+            isBigEndian = false;
+            i = 2;
+        }
+    }
+
+    while (i + 2 <= length) {
+        copyAscii(p, length, isBigEndian, &i, &o);
+        if (i + 2 > length)
+            break;
+        uint32_t c = unitAt(p + i, isBigEndian);
+        if (c == 0)
+            return (char*)o;
+        i += 2;
+        if (c >= 0xD800 && c <= 0xDFFF) {
+            uint32_t low = i + 2 <= length ? unitAt(p + i, isBigEndian) : 0;
+            if (c <= 0xDBFF && low >= 0xDC00 && low <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            } else {
+                // a lead surrogate and an odd last byte are one
+                // truncated char.
+                if (c <= 0xDBFF && i + 2 > length)
+                    i = length;
+                c = 0xFFFD;
+            }
+        }
+        o = encodeUtf8(c, o);
+    }
+    if (i < length)
+        o = encodeUtf8(0xFFFD, o);
+    return (char*)o;
+}
+
+}
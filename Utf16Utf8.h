@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UTF16_UTF8_H
+#define UTF16_UTF8_H
+
+#include <stddef.h>
+
+namespace android {
+
+// Byte order of UTF-16 that has no BOM. ID3v2 text encoding 1 has one,
+// encoding 2 is big endian without.
+enum Utf16ByteOrder {
+    kUtf16BigEndian,
+    kUtf16LittleEndian,
+};
+
+// Bytes utf16ToUtf8() may write for length bytes of UTF-16.
+static inline size_t utf16Utf8Bound(size_t length) {
+    return length / 2 * 3 + 3;
+}
+
+// Converts the UTF-16 in bytes to UTF-8 at out, which must hold
+// utf16Utf8Bound(length) bytes, and returns the end of it; no zero is
+// written. A BOM at the start overrides order and is dropped, and the
+// conversion stops at a zero code unit, which ends the value in a frame.
+// Unpaired surrogates and an odd last byte become U+FFFD, as with ICU.
+// Runs of ASCII go 8 code units at a time with SSE2 or NEON.
+char* utf16ToUtf8(const char* bytes, size_t length, Utf16ByteOrder order, char* out);
+
+}
+
+#endif // UTF16_UTF8_H
@@ -1,7 +1,9 @@
 #!/usr/bin/python
 # -*- coding: utf-8 -*-
 
-# make_testee.py - make testee.h from cddb
+# make_testee.py - make testee.h and testee.bin from cddb
+#
+# usage: make_testee.py [-a DIR] [-j JOBS] [-s SEED] [corpus items for each encoding]
 #
 # Copyright (C) 2011 Homin Lee <ff4500@gmail.com>
 #
@@ -11,9 +13,15 @@
 # (at your option) any later version.
 
 import os
+import sys
 import glob
+import heapq
+import struct
+import hashlib
+import tarfile
 import chardet
-import random
+import optparse
+import multiprocessing
 
 freedbAddr = "http://ftp.freedb.org/pub/freedb/"
 dbNameTemplete = "freedb-update-%s-%s.tar.bz2"
@@ -24,57 +32,70 @@ yearEnd, monthEnd = 2010, 12
 itemCntForEachEncoding = 50
 outputName = "testee.h"
 
+# testee.bin isn't compiled in, so it can hold many more strings.
+corpusItemCntForEachEncoding = 10000
+corpusName = "testee.bin"
+
 # hardly find SHIFT-JIS strings. so made it from EUC-JP strings
 encodings = ['utf-8', 'windows-1252', 'EUC-KR', 'EUC-JP', 'Big5', 'GB2312']
 
-for y in range(yearStart, yearEnd + 1):
-    for m in range(monthStart, monthEnd + 1):
-        y_b = y
-        m_b = m + 1
-        if m_b > 12:
-            y_b += 1
-            m_b = 1
-
-        dbName = dbNameTemplete %\
-            ("%04d%02d01"%(y, m),\
-            "%04d%02d01"%(y_b, m_b))
-
-        if os.path.exists(dbName):
-            continue
-
-        downAddr = freedbAddr + dbName
-        #print downAddr
-        os.system("wget " + downAddr)
-
-os.system('mkdir -p cddb')
-
-for z in glob.glob("*.tar.bz2"):
-    os.system("tar -C cddb -xvjf " + z)
-
-cds = glob.glob("cddb/*/*")
-print "Generating %s from %d cddb items.."%(outputName, len(cds))
-
-testeeDict = {}
-
-def escapeAscii(text):
-    retText = ''
-    for c in text:
-        if 1:#ord(c)&0x80:
-            retText += r"\x%02X"%ord(c)
-        else:
-            retText += c
-    return retText
-
-random.shuffle(cds)
-for cd in cds:
-    if os.path.isdir(cd):
-        continue
-
-    enc = chardet.detect(open(cd).read())['encoding']
+# cddb entries handed to the workers at a time; bounds the memory used
+# however large the archives are.
+batchSize = 4096
+
+parser = optparse.OptionParser(
+    usage="%prog [options] [corpus items for each encoding]")
+parser.add_option("-a", "--archives", metavar="DIR",
+    help="read the freedb .tar.bz2 archives in DIR instead of downloading them")
+parser.add_option("-j", "--jobs", type="int", default=multiprocessing.cpu_count(),
+    help="processes running chardet [%default]")
+parser.add_option("-s", "--seed", default="0",
+    help="picks the items sampled for each encoding [%default]")
+options, args = parser.parse_args()
+if args:
+    corpusItemCntForEachEncoding = int(args[0])
+
+def download(dir):
+    for y in range(yearStart, yearEnd + 1):
+        for m in range(monthStart, monthEnd + 1):
+            y_b = y
+            m_b = m + 1
+            if m_b > 12:
+                y_b += 1
+                m_b = 1
+
+            dbName = dbNameTemplete %\
+                ("%04d%02d01"%(y, m),\
+                "%04d%02d01"%(y_b, m_b))
+
+            if os.path.exists(os.path.join(dir, dbName)):
+                continue
+
+            downAddr = freedbAddr + dbName
+            #print downAddr
+            os.system("wget -P %s %s"%(dir, downAddr))
+
+# cddb entries of the archives in dir, read straight from the compressed
+# streams; nothing is extracted to disk.
+def cddbEntries(dir):
+    for z in sorted(glob.glob(os.path.join(dir, "*.tar.bz2"))):
+        print 'reading %s..'%z
+        tar = tarfile.open(z, 'r|bz2')
+        for member in tar:
+            if not member.isfile():
+                continue
+            yield member.name, tar.extractfile(member).read()
+        tar.close()
+
+# (name, encoding, title) of the first title of a cddb entry in the
+# encoding of the whole entry, or None. Runs in the worker processes.
+def detect(entry):
+    name, data = entry
+    enc = chardet.detect(data)['encoding']
     if not enc in encodings:
-        continue
+        return None
 
-    for line in open(cd):
+    for line in data.splitlines():
         if not line.startswith('TTITLE'):
             continue
         lineEnc = chardet.detect(line)['encoding']
@@ -85,32 +106,67 @@ for cd in cds:
         if not text:
             continue
 
-        #print enc, text
-        #if not enc: enc = "None"
-
+        return name, enc, text
+    return None
+
+# The items kept for an encoding are those with the smallest hash of the
+# seed and their entry name. That is a random sample, the same for a seed
+# whatever order the workers finish in.
+def sampleKey(name):
+    return hashlib.md5(options.seed + '/' + name).hexdigest()
+
+def batches(entries):
+    batch = []
+    for entry in entries:
+        batch.append(entry)
+        if len(batch) == batchSize:
+            yield batch
+            batch = []
+    if batch:
+        yield batch
+
+archiveDir = options.archives
+if not archiveDir:
+    archiveDir = '.'
+    download(archiveDir)
+
+print "Generating %s and %s with %d processes.."%(outputName, corpusName, options.jobs)
+
+# per encoding, a heap of (-key, text) of the items kept so far
+samples = {}
+pool = multiprocessing.Pool(options.jobs)
+entryCnt = 0
+for batch in batches(cddbEntries(archiveDir)):
+    entryCnt += len(batch)
+    for found in pool.imap_unordered(detect, batch, 64):
+        if not found:
+            continue
+        name, enc, text = found
 
-        if not enc in testeeDict.keys():
-            testeeDict[enc] = [text]
+        if not enc in samples.keys():
+            samples[enc] = []
             print 'find new encoding, %s'%enc
-            break
-        elif len(testeeDict[enc]) < itemCntForEachEncoding:
-            testeeDict[enc] += [text]
-            break
-
-    isEnough = True
-    for enc in encodings:
-        if not enc in testeeDict.keys():
-            isEnough = False
-            break
-        if len(testeeDict[enc]) < itemCntForEachEncoding:
-            isEnough = False
-            break
-
-    if isEnough:
-        break
-
+        item = (-int(sampleKey(name), 16), text)
+        if len(samples[enc]) < corpusItemCntForEachEncoding:
+            heapq.heappush(samples[enc], item)
+        elif item > samples[enc][0]:
+            heapq.heapreplace(samples[enc], item)
+pool.close()
+pool.join()
+print '%d cddb items read'%entryCnt
 
+testeeDict = {}
+for enc in samples.keys():
+    testeeDict[enc] = [text for key, text in sorted(samples[enc], reverse=True)]
 
+def escapeAscii(text):
+    retText = ''
+    for c in text:
+        if 1:#ord(c)&0x80:
+            retText += r"\x%02X"%ord(c)
+        else:
+            retText += c
+    return retText
 
 # if no shift-jis found make it from euc-jp
 if not "SHIFT-JIS" in testeeDict.keys():
@@ -129,13 +185,13 @@ wp.write('''struct str_pair {
 struct enc_table {
     const char *encoding;
     struct str_pair *table;
+    unsigned int size;
 };\n\n''')
 
-for enc in testeeDict.keys():
-    if enc == "EUC-JP":
-        continue
+tableEncs = [enc for enc in testeeDict.keys() if enc != "EUC-JP"]
+for enc in tableEncs:
     wp.write("struct str_pair strs_%s[] = {\n"%enc.replace('-', '_'))
-    for text in testeeDict[enc]:
+    for text in testeeDict[enc][:itemCntForEachEncoding]:
         text = text.replace('"', '\\"')
         if enc == 'None':
             wp.write('    {"%s", "%s"},\n'%(escapeAscii(text), escapeAscii(text)))
@@ -150,7 +206,63 @@ for enc in testeeDict.keys():
                         %(escapeAscii(text), "???"))
     wp.write("};\n\n")
 
+# the registry of the tables above, for the tests to run over
+wp.write("struct enc_table enc_tables[] = {\n")
+for enc in tableEncs:
+    table = "strs_%s"%enc.replace('-', '_')
+    wp.write('    {"%s", %s, sizeof(%s)/sizeof(struct str_pair)},\n'%(enc, table, table))
+wp.write("};\n\n")
+wp.write("const unsigned int enc_table_count = sizeof(enc_tables)/sizeof(struct enc_table);\n")
+
 wp.close()
 
-#os.system("rm -rf cddb")
-#os.system("rm *.tar.bz2")
+
+# testee.bin: see TesteeCorpus.h for the layout. Every field is a little
+# endian uint32 and every string is zero terminated.
+def writeCorpus(name, testeeDict):
+    encs = [enc for enc in testeeDict.keys() if enc != "EUC-JP"]
+
+    pairs = {}
+    for enc in encs:
+        pairs[enc] = []
+        for text in testeeDict[enc]:
+            try:
+                pairs[enc] += [(text, text.decode(enc).encode('utf-8'))]
+            except:
+                pass # can't decode by python!
+
+    indexOffset = 16 + 16 * len(encs)
+    stringOffset = indexOffset + 16 * sum([len(pairs[enc]) for enc in encs])
+
+    directory = []
+    index = []
+    strings = []
+    offset = [stringOffset]
+
+    def addString(s):
+        strings.append(s + '\0')
+        offset[0] += len(s) + 1
+        return offset[0] - len(s) - 1
+
+    for enc in encs:
+        nameOffset = addString(enc)
+        directory.append(struct.pack('<4I', nameOffset, len(pairs[enc]), indexOffset, 0))
+        for native, utf8 in pairs[enc]:
+            nativeOffset = addString(native)
+            utf8Offset = addString(utf8)
+            index.append(struct.pack('<4I',
+                nativeOffset, len(native), utf8Offset, len(utf8)))
+        indexOffset += 16 * len(pairs[enc])
+
+    # "TSTE", version 1
+    header = struct.pack('<4I', 0x45545354, 1, len(encs), offset[0])
+
+    wp = open(name, 'wb')
+    wp.write(header)
+    wp.write(''.join(directory))
+    wp.write(''.join(index))
+    wp.write(''.join(strings))
+    wp.close()
+
+print 'write corpus to %s'%corpusName
+writeCorpus(corpusName, testeeDict)
@@ -0,0 +1,53 @@
+#!/system/bin/sh
+#
+# Copyright (C) 2010 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Runs the test binary as JOBS gtest shards at once, and prints the log
+# of each shard that fails.
+#
+#   run_tests.sh [-j JOBS] [binary [gtest args]]
+
+jobs=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+if [ "$1" = "-j" ]; then
+    jobs=$2
+    shift 2
+fi
+binary=${1:-/system/bin/MediaScannerClient_test}
+[ $# -gt 0 ] && shift
+logs=${TMPDIR:-/data/local/tmp}/MediaScannerClient_test.$$
+
+pids=
+shard=0
+while [ $shard -lt $jobs ]; do
+    GTEST_TOTAL_SHARDS=$jobs GTEST_SHARD_INDEX=$shard \
+        "$binary" "$@" > $logs.$shard 2>&1 &
+    pids="$pids $!"
+    shard=$((shard + 1))
+done
+
+failed=0
+shard=0
+for pid in $pids; do
+    if ! wait $pid; then
+        echo "shard $shard of $jobs failed:"
+        cat $logs.$shard
+        failed=1
+    fi
+    rm -f $logs.$shard
+    shard=$((shard + 1))
+done
+
+[ $failed -eq 0 ] && echo "$jobs shards passed"
+exit $failed
@@ -6,6 +6,7 @@ struct str_pair {
 struct enc_table {
     const char *encoding;
     struct str_pair *table;
+    unsigned int size;
 };
 
 struct str_pair strs_EUC_KR[] = {
@@ -291,3 +292,13 @@ struct str_pair strs_windows_1252[] = {
     {"\x57\x69\x6C\x64\x73\x63\x68\xFC\x74\x7A\x20\x52\xE4\x70", "Wildschütz Räp"},
 };
 
+struct enc_table enc_tables[] = {
+    {"EUC-KR", strs_EUC_KR, sizeof(strs_EUC_KR)/sizeof(struct str_pair)},
+    {"GB2312", strs_GB2312, sizeof(strs_GB2312)/sizeof(struct str_pair)},
+    {"Big5", strs_Big5, sizeof(strs_Big5)/sizeof(struct str_pair)},
+    {"SHIFT-JIS", strs_SHIFT_JIS, sizeof(strs_SHIFT_JIS)/sizeof(struct str_pair)},
+    {"utf-8", strs_utf_8, sizeof(strs_utf_8)/sizeof(struct str_pair)},
+    {"windows-1252", strs_windows_1252, sizeof(strs_windows_1252)/sizeof(struct str_pair)},
+};
+
+const unsigned int enc_table_count = sizeof(enc_tables)/sizeof(struct enc_table);